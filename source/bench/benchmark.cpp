@@ -0,0 +1,115 @@
+// The driver of the benchmarks, it is built apart from the library.
+// Usage:
+//   benchmark search [paletteSize] [queryCount]
+//   benchmark zip <packDir> <outputZip> [threadCount]
+//   benchmark load <blockInfoFile> [repeatCount]
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../file_processing.hpp"
+#include "../preprocess.hpp"
+#include "../quantizer.hpp"
+
+static const char *simdName(Quantizer::SimdLevel level) {
+    switch (level) {
+    case Quantizer::SimdLevel::Avx2:
+        return "avx2";
+    case Quantizer::SimdLevel::Sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+// @brief Times the palette search methods on the random palettes, every size if the size is 0.
+static int benchSearch(int paletteSize, int queryCount) {
+    const int sizes[] = { 16, 64, 256, 1024 };
+    std::printf("%8s %10s %10s %10s %10s %8s\n", "palette", "linear ns", "kdtree ns", "soa ns", "simd", "mismatch");
+    for (int size : sizes) {
+        if (paletteSize > 0)
+            size = paletteSize;
+        BIModis modis;
+        std::mt19937 rng(size);
+        std::uniform_int_distribution<int> uni(0, 255);
+        for (int i = 0; i < size; ++i)
+            modis.emplace_back("block_" + std::to_string(i), "", Rgb(uni(rng), uni(rng), uni(rng)));
+        Quantizer::SearchBenchmark result = Quantizer::benchmarkSearch(modis, 0, queryCount);
+        std::printf("%8d %10.1f %10.1f %10.1f %10s %8d\n", result.paletteSize, result.linear, result.kdTree,
+                    result.soa, simdName(result.simdLevel), result.mismatched);
+        if (paletteSize > 0)
+            break;
+    }
+    return 0;
+}
+
+// @brief Times the zip settings on the files of the pack directory, the zip file is overwritten by every setting.
+static int benchZip(const std::string &packDir, const std::string &outputZip, int threadCount) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (!fs::is_directory(packDir, error)) {
+        std::fprintf(stderr, "The pack directory %s is invalid.\n", packDir.c_str());
+        return 1;
+    }
+    std::vector<std::string> names;
+    std::vector<std::string> datas;
+    for (auto &item : fs::recursive_directory_iterator(packDir)) {
+        if (!item.is_regular_file())
+            continue;
+        std::ifstream file(item.path(), std::ios::binary);
+        std::ostringstream data;
+        data << file.rdbuf();
+        names.push_back(fs::relative(item.path(), packDir).generic_string());
+        datas.push_back(data.str());
+    }
+    std::vector<ZipEntry> entries;
+    for (std::size_t i = 0; i < names.size(); ++i)
+        entries.push_back({ names[i], &datas[i] });
+
+    std::vector<ZipBenchmark> results = benchmarkZip(entries, outputZip, threadCount);
+    if (results.empty()) {
+        std::fprintf(stderr, "The zip file %s can not be written.\n", outputZip.c_str());
+        return 1;
+    }
+    std::printf("%zu entries\n", entries.size());
+    std::printf("%20s %8s %12s %12s %8s %10s\n", "setting", "threads", "raw bytes", "zip bytes", "ratio", "seconds");
+    for (auto &result : results) {
+        std::printf("%20s %8d %12zu %12zu %8.3f %10.3f\n", result.setting.c_str(), result.threadCount,
+                    result.rawSize, result.zipSize, result.ratio(), result.seconds);
+    }
+    return 0;
+}
+
+// @brief Times the old and the current loading of the block info file.
+static int benchLoad(const std::string &filepath, int repeatCount) {
+    LoadBenchmark result = benchmarkBIRawsLoad(filepath, repeatCount);
+    if (result.blockCount == 0) {
+        std::fprintf(stderr, "The block info file %s is invalid.\n", filepath.c_str());
+        return 1;
+    }
+    std::printf("%12s %8s %14s %14s %10s\n", "file bytes", "blocks", "word dom ms", "mapped sax ms", "mismatch");
+    std::printf("%12zu %8d %14.2f %14.2f %10d\n", result.fileSize, result.blockCount, result.wordDom,
+                result.mappedSax, result.mismatched);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "search")
+        return benchSearch(argc > 2 ? std::atoi(argv[2]) : 0, argc > 3 ? std::atoi(argv[3]) : 1 << 18);
+    if (command == "zip" && argc > 3)
+        return benchZip(argv[2], argv[3], argc > 4 ? std::atoi(argv[4]) : 0);
+    if (command == "load" && argc > 2)
+        return benchLoad(argv[2], argc > 3 ? std::atoi(argv[3]) : 5);
+    std::fprintf(stderr, "Usage:\n"
+                 "  benchmark search [paletteSize] [queryCount]\n"
+                 "  benchmark zip <packDir> <outputZip> [threadCount]\n"
+                 "  benchmark load <blockInfoFile> [repeatCount]\n");
+    return 1;
+}
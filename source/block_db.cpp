@@ -0,0 +1,311 @@
+#include "block_db.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+// The string index of the missing string.
+constexpr std::uint32_t _NoString = 0xffffffff;
+
+// The tag of the byte order, it is read as another value in the other byte order.
+constexpr std::uint32_t _ByteOrder = 0x01020304;
+
+// The header of the compiled file, the sections follow it in order:
+// the records, the version entries, the string offsets and the string bytes.
+// @note The sections are written as they are in the memory, so the structs have no padding bytes.
+struct BlockDb::Header
+{
+    char magic[4] = { 'M', 'C', 'B', 'D' };
+    std::uint32_t byteOrder = _ByteOrder;
+    std::uint32_t formatVersion = 3;
+    std::uint32_t blockCount = 0;
+    std::uint32_t versionCount = 0;
+    std::uint32_t stringCount = 0;
+    std::uint32_t stringBytes = 0;
+    std::uint32_t reserved = 0;
+    // The size and the modification time of the source file, the compiled file is stale if they change.
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceTime = 0;
+};
+
+struct BlockDb::Record
+{
+    // The version entries range of the block ids, in the order of the source.
+    std::uint32_t idBegin = 0;
+    std::uint32_t idCount = 0;
+    std::uint32_t textures[BlockFlag::_FaceSlotCount] = {};
+    std::int32_t attribute = 0;
+    std::uint32_t debutVersion = 0;
+    std::uint8_t colors[BlockFlag::_FaceSlotCount][3] = {};
+    // The face slots which have the texture or the color.
+    std::uint8_t textureMask = 0;
+    std::uint8_t colorMask = 0;
+    std::uint8_t alignment = 0;
+};
+
+struct BlockDb::VersionEntry
+{
+    std::uint32_t version = 0;
+    std::uint32_t id = 0;
+};
+
+static inline std::uint32_t packVersion(const Version &version) {
+    return static_cast<std::uint32_t>(version.data());
+}
+
+static inline Version unpackVersion(std::uint32_t version) {
+    return Version(static_cast<unsigned char>(version >> 24), static_cast<unsigned char>((version >> 16) & 0xff),
+                   static_cast<unsigned char>(version & 0xff));
+}
+
+// @brief Gets the size and the modification time of the source file.
+static bool getSourceStamp(const std::string &sourcePath, std::uint64_t &size, std::int64_t &time) {
+    std::error_code error;
+    auto fileSize = std::filesystem::file_size(sourcePath, error);
+    if (error)
+        return false;
+    auto fileTime = std::filesystem::last_write_time(sourcePath, error);
+    if (error)
+        return false;
+    size = static_cast<std::uint64_t>(fileSize);
+    time = static_cast<std::int64_t>(fileTime.time_since_epoch().count());
+    return true;
+}
+
+template<typename T>
+static void appendPod(std::string &buffer, const T &value) {
+    // The padding bytes would be written uninitialized.
+    static_assert(std::has_unique_object_representations_v<T>, "The struct must have no padding bytes.");
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+std::string BlockDb::compileData(const BIRaws &raws, const std::string &sourcePath) {
+    Header header;
+    if (!getSourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+        return std::string();
+
+    // Interns the block ids and the texture names.
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, std::uint32_t> stringIndices;
+    auto intern = [&](const std::string &str) {
+        auto it = stringIndices.find(str);
+        if (it != stringIndices.end())
+            return it->second;
+        std::uint32_t index = static_cast<std::uint32_t>(strings.size());
+        stringIndices.insert({ str, index });
+        strings.push_back(str);
+        return index;
+    };
+
+    std::vector<Record> records(raws.size());
+    std::vector<VersionEntry> versions;
+    for (std::size_t i = 0; i < raws.size(); ++i) {
+        const BlockInfoRaw &raw = raws[i];
+        Record &record = records[i];
+        record.idBegin = static_cast<std::uint32_t>(versions.size());
+        record.idCount = static_cast<std::uint32_t>(raw.ids.size());
+        for (auto &id : raw.ids) {
+            VersionEntry entry;
+            entry.version = packVersion(id.first);
+            entry.id = intern(id.second);
+            versions.push_back(entry);
+        }
+        for (int slot = 0; slot < BlockFlag::_FaceSlotCount; ++slot)
+            record.textures[slot] = _NoString;
+        for (int slot = 0; slot < BlockFlag::_FaceSlotCount; ++slot) {
+            if (raw.hasTexture(slot))
+                record.textures[slot] = intern(raw.facesTexturePath[slot]);
+            if (raw.hasColor(slot)) {
+                record.colors[slot][0] = raw.facesColor[slot].r;
+                record.colors[slot][1] = raw.facesColor[slot].g;
+                record.colors[slot][2] = raw.facesColor[slot].b;
+            }
+        }
+        record.textureMask = raw.textureMask;
+        record.colorMask = raw.colorMask;
+        record.attribute = raw.attribute;
+        record.debutVersion = packVersion(raw.debutVersion);
+        record.alignment = static_cast<std::uint8_t>(raw.alignment);
+    }
+
+    std::vector<std::uint32_t> stringOffsets(1, 0);
+    for (auto &str : strings)
+        stringOffsets.push_back(stringOffsets.back() + static_cast<std::uint32_t>(str.size()));
+    header.blockCount = static_cast<std::uint32_t>(records.size());
+    header.versionCount = static_cast<std::uint32_t>(versions.size());
+    header.stringCount = static_cast<std::uint32_t>(strings.size());
+    header.stringBytes = stringOffsets.back();
+
+    std::string data;
+    data.reserve(sizeof(header) + records.size() * sizeof(Record) + versions.size() * sizeof(VersionEntry) +
+                 stringOffsets.size() * sizeof(std::uint32_t) + header.stringBytes);
+    appendPod(data, header);
+    for (auto &record : records)
+        appendPod(data, record);
+    for (auto &entry : versions)
+        appendPod(data, entry);
+    for (auto offset : stringOffsets)
+        appendPod(data, offset);
+    for (auto &str : strings)
+        data += str;
+    return data;
+}
+
+bool BlockDb::bind(const char *data, std::size_t size, const std::string &sourcePath) {
+    Header expected;
+    if (data == nullptr || size < sizeof(Header))
+        return false;
+    const Header *header = reinterpret_cast<const Header *>(data);
+    if (std::memcmp(header->magic, expected.magic, sizeof(expected.magic)) != 0 ||
+        header->byteOrder != expected.byteOrder || header->formatVersion != expected.formatVersion)
+        return false;
+    if (!getSourceStamp(sourcePath, expected.sourceSize, expected.sourceTime) ||
+        header->sourceSize != expected.sourceSize || header->sourceTime != expected.sourceTime)
+        return false;
+    std::size_t recordsOffset = sizeof(Header);
+    std::size_t versionsOffset = recordsOffset + std::size_t(header->blockCount) * sizeof(Record);
+    std::size_t stringOffsetsOffset = versionsOffset + std::size_t(header->versionCount) * sizeof(VersionEntry);
+    std::size_t stringsOffset = stringOffsetsOffset + (std::size_t(header->stringCount) + 1) * sizeof(std::uint32_t);
+    if (size != stringsOffset + header->stringBytes)
+        return false;
+
+    const Record *records = reinterpret_cast<const Record *>(data + recordsOffset);
+    const VersionEntry *versions = reinterpret_cast<const VersionEntry *>(data + versionsOffset);
+    const std::uint32_t *stringOffsets = reinterpret_cast<const std::uint32_t *>(data + stringOffsetsOffset);
+    // Checks the indices once, so the accessors need not.
+    if (stringOffsets[0] != 0 || stringOffsets[header->stringCount] != header->stringBytes)
+        return false;
+    for (std::uint32_t i = 0; i < header->stringCount; ++i) {
+        if (stringOffsets[i] > stringOffsets[i + 1])
+            return false;
+    }
+    for (std::uint32_t i = 0; i < header->versionCount; ++i) {
+        if (versions[i].id >= header->stringCount)
+            return false;
+    }
+    for (std::uint32_t i = 0; i < header->blockCount; ++i) {
+        const Record &record = records[i];
+        if (record.idBegin > header->versionCount || record.idCount > header->versionCount - record.idBegin)
+            return false;
+        for (int slot = 0; slot < BlockFlag::_FaceSlotCount; ++slot) {
+            if ((record.textureMask >> slot & 1) && record.textures[slot] >= header->stringCount)
+                return false;
+        }
+    }
+
+    header_ = header;
+    records_ = records;
+    versions_ = versions;
+    stringOffsets_ = stringOffsets;
+    strings_ = data + stringsOffset;
+    return true;
+}
+
+std::string BlockDb::string(std::uint32_t index) const {
+    return std::string(strings_ + stringOffsets_[index], stringOffsets_[index + 1] - stringOffsets_[index]);
+}
+
+BlockDb BlockDb::open(const std::string &filepath, const std::string &sourcePath) {
+    BlockDb result;
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(filepath) || !result.bind(file->data(), file->size(), sourcePath))
+        return BlockDb();
+    result.file_ = file;
+    return result;
+}
+
+// @brief Writes the compiled data into the file.
+static bool writeData(const std::string &filepath, const std::string &data) {
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Failed to open file." << std::endl;
+        return false;
+    }
+    file.write(data.data(), data.size());
+    file.close();
+    if (!file.good()) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Failed to write file." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool BlockDb::compile(const BIRaws &raws, const std::string &filepath, const std::string &sourcePath) {
+    std::string data = compileData(raws, sourcePath);
+    return !data.empty() && writeData(filepath, data);
+}
+
+BlockDb BlockDb::load(const std::string &filepath, const std::string &sourcePath) {
+    BlockDb result = open(filepath, sourcePath);
+    if (!result.empty())
+        return result;
+
+    BIRaws raws = getBIRawsByDomFile(sourcePath);
+    if (raws.empty())
+        return result;
+    auto data = std::make_shared<std::string>(compileData(raws, sourcePath));
+    if (data->empty())
+        return result;
+    if (writeData(filepath, *data)) {
+        result = open(filepath, sourcePath);
+        if (!result.empty())
+            return result;
+    }
+    // Keeps the compiled data in the memory if the file can not be written or mapped.
+    if (result.bind(data->data(), data->size(), sourcePath))
+        result.data_ = data;
+    return result;
+}
+
+std::size_t BlockDb::size() const {
+    return header_ == nullptr ? 0 : header_->blockCount;
+}
+
+BIRaws BlockDb::raws() const {
+    BIRaws result(size());
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        const Record &record = records_[i];
+        BlockInfoRaw &raw = result[i];
+        for (std::uint32_t j = record.idBegin; j < record.idBegin + record.idCount; ++j)
+            raw.ids.push_back({ unpackVersion(versions_[j].version), string(versions_[j].id) });
+        for (int slot = 0; slot < BlockFlag::_FaceSlotCount; ++slot) {
+            if (record.textureMask >> slot & 1)
+                raw.setTexture(BlockFlag::slotFace(slot), string(record.textures[slot]));
+            if (record.colorMask >> slot & 1)
+                raw.setColor(BlockFlag::slotFace(slot),
+                             Rgb(record.colors[slot][0], record.colors[slot][1], record.colors[slot][2]));
+        }
+        raw.debutVersion = unpackVersion(record.debutVersion);
+        raw.alignment = static_cast<char>(record.alignment);
+        raw.attribute = record.attribute;
+    }
+    return result;
+}
+
+BIModis BlockDb::modis(int face, int alignment, int attribute, Version debutVersion) const {
+    BIModis result;
+    PaletteFilter filter(face, alignment, attribute, debutVersion);
+    for (std::size_t i = 0; i < size(); ++i) {
+        const Record &record = records_[i];
+        int textureSlot = 0;
+        int colorSlot = 0;
+        if (!filter.pick(record.alignment, record.attribute, unpackVersion(record.debutVersion), record.textureMask,
+                         record.colorMask, textureSlot, colorSlot))
+            continue;
+        const VersionEntry *idEnd = versions_ + record.idBegin + record.idCount;
+        const VersionEntry *id = lowerVersion(versions_ + record.idBegin, idEnd, debutVersion,
+                                              [](const VersionEntry &entry) { return unpackVersion(entry.version); });
+        std::string blockId = id != idEnd ? string(id->id) : std::string();
+        const std::uint8_t *color = record.colors[colorSlot];
+        result.emplace_back(BlockInfoModified(blockId, string(record.textures[textureSlot]),
+                                              Rgb(color[0], color[1], color[2])));
+    }
+    return result;
+}
@@ -0,0 +1,67 @@
+#ifndef BLOCK_DB_HPP
+#define BLOCK_DB_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "preprocess.hpp"
+
+class MappedFile;
+
+// @brief The block infos compiled into a binary file, it is mapped and used without parsing.
+// @note The file has the interned strings, the per face colors and texture names, the alignment and attribute
+//       bitmasks and the version tables, in the native byte order. The byte order is tagged in the header, the
+//       file of the other byte order is invalid and compiled again. The copies share the same data.
+class BlockDb
+{
+public:
+    BlockDb() {}
+
+    // @brief Opens the compiled file of the source file, or compiles it from the source file if it is stale.
+    // @param filepath The compiled file, it is rewritten when it is stale.
+    // @param sourcePath The JSON file of the block infos.
+    // @note If the compiled file can not be written, the compiled data is kept in the memory.
+    static BlockDb load(const std::string &filepath, const std::string &sourcePath);
+
+    // @brief Maps the compiled file.
+    // @return The empty database if the file is invalid or it is not compiled from the current source file.
+    static BlockDb open(const std::string &filepath, const std::string &sourcePath);
+
+    // @brief Compiles the block infos of the source file into the compiled file.
+    static bool compile(const BIRaws &raws, const std::string &filepath, const std::string &sourcePath);
+
+    bool empty() const {
+        return header_ == nullptr;
+    }
+    std::size_t size() const;
+
+    // @brief Gets the block infos as getBIRawsByDomFile() does.
+    BIRaws raws() const;
+
+    // @brief Gets the palette as rawsToModis() does, the records are filtered in place.
+    BIModis modis(int face, int alignment, int attribute, Version debutVersion) const;
+
+private:
+    struct Header;
+    struct Record;
+    struct VersionEntry;
+
+    // @brief Compiles the block infos into the memory.
+    // @return The empty string if the source file can not be stamped.
+    static std::string compileData(const BIRaws &raws, const std::string &sourcePath);
+
+    // @brief Points to the data if it is valid.
+    bool bind(const char *data, std::size_t size, const std::string &sourcePath);
+    std::string string(std::uint32_t index) const;
+
+    const Header *header_ = nullptr;
+    const Record *records_ = nullptr;
+    const VersionEntry *versions_ = nullptr;
+    const std::uint32_t *stringOffsets_ = nullptr;
+    const char *strings_ = nullptr;
+    std::shared_ptr<MappedFile> file_;
+    std::shared_ptr<std::string> data_;
+};
+
+#endif // !BLOCK_DB_HPP
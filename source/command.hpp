@@ -3,6 +3,7 @@
 
 #include <string>
 #include <array>
+#include <charconv>
 
 namespace Command
 {
@@ -76,6 +77,204 @@ enum class FillMode : char
 namespace Command
 {
 
+// The appenders write the command to the end of the buffer without the temporary strings, so a reused buffer
+// needs no allocation once it is large enough. The sub command of execute is written by a callable which takes
+// the buffer, the nested commands are composed in place.
+
+inline void appendInt(std::string &buffer, int value) {
+    char digits[16];
+    char *end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    buffer.append(digits, end);
+}
+
+inline void appendPos(std::string &buffer, const std::array<int, 3> &pos, PosMode posMode) {
+    const char *mode = _PosMode[static_cast<int>(posMode)];
+    for (int i = 0; i < 3; ++i) {
+        if (i != 0)
+            buffer += ' ';
+        buffer += mode;
+        appendInt(buffer, pos[i]);
+    }
+}
+
+inline void appendSetblock(std::string &buffer, const std::string &blockId,
+                           const std::array<int, 3> &pos,
+                           PosMode posMode = PosMode::Absolute,
+                           SetblockMode mode = SetblockMode::Replace,
+                           bool hasSlash = false)
+{
+    if (hasSlash)
+        buffer += '/';
+    buffer += "setblock ";
+    appendPos(buffer, pos, posMode);
+    buffer += ' ';
+    buffer += blockId;
+    buffer += ' ';
+    buffer += _SetblockMode[static_cast<int>(mode)];
+}
+
+inline void appendFill(std::string &buffer, const std::string &blockId,
+                       const std::array<int, 3> &posFrom,
+                       const std::array<int, 3> &posTo,
+                       PosMode posMode = PosMode::Absolute,
+                       FillMode mode = FillMode::Replace,
+                       const std::string &replacedBlockId = std::string(),
+                       bool hasSlash = false)
+{
+    if (hasSlash)
+        buffer += '/';
+    buffer += "fill ";
+    appendPos(buffer, posFrom, posMode);
+    buffer += ' ';
+    appendPos(buffer, posTo, posMode);
+    buffer += ' ';
+    buffer += blockId;
+    buffer += ' ';
+    buffer += _FillMode[static_cast<int>(mode)];
+    if (replacedBlockId.empty() || mode != FillMode::Replace)
+        return;
+    buffer += ' ';
+    buffer += replacedBlockId;
+}
+
+inline void appendParticle(std::string &buffer, const std::string &particleId,
+                           const std::array<int, 3> &pos,
+                           PosMode posMode = PosMode::Absolute,
+                           bool hasSlash = false)
+{
+    if (hasSlash)
+        buffer += '/';
+    buffer += "particle ";
+    appendPos(buffer, pos, posMode);
+    buffer += ' ';
+    buffer += particleId;
+}
+
+template<typename SubCommand>
+inline void appendOldExecute(std::string &buffer, const std::string &targetEntityId,
+                             const std::array<int, 3> &pos,
+                             SubCommand subCommand,
+                             PosMode posMode = PosMode::Absolute,
+                             bool hasSlash = false)
+{
+    if (hasSlash)
+        buffer += '/';
+    buffer += "execute ";
+    buffer += targetEntityId;
+    buffer += ' ';
+    appendPos(buffer, pos, posMode);
+    buffer += ' ';
+    subCommand(buffer);
+}
+
+// @note The target is the selector, no string is made for it.
+template<typename SubCommand>
+inline void appendOldExecute(std::string &buffer, Selector target,
+                             const std::array<int, 3> &pos,
+                             SubCommand subCommand,
+                             PosMode posMode = PosMode::Absolute,
+                             bool hasSlash = false)
+{
+    if (hasSlash)
+        buffer += '/';
+    buffer += "execute ";
+    buffer += _Selector[static_cast<int>(target)];
+    buffer += ' ';
+    appendPos(buffer, pos, posMode);
+    buffer += ' ';
+    subCommand(buffer);
+}
+
+template<typename SubCommand>
+inline void appendOldExecute(std::string &buffer, const std::string &targetEntityId,
+                             const std::array<int, 3> &executePos,
+                             const std::array<int, 3> &detectPos,
+                             const std::string &blockId, int data,
+                             SubCommand subCommand,
+                             PosMode executePosMode = PosMode::Absolute,
+                             PosMode detectPosMode = PosMode::Absolute,
+                             bool hasSlash = false)
+{
+    if (hasSlash)
+        buffer += '/';
+    buffer += "execute ";
+    buffer += targetEntityId;
+    buffer += ' ';
+    appendPos(buffer, executePos, executePosMode);
+    buffer += " detect ";
+    appendPos(buffer, detectPos, detectPosMode);
+    buffer += ' ';
+    buffer += blockId;
+    buffer += ' ';
+    appendInt(buffer, data);
+    buffer += ' ';
+    subCommand(buffer);
+}
+
+// @note The decorate and condition are written by the callables too.
+template<typename Decorate, typename Condition, typename SubCommand>
+inline void appendExecute(std::string &buffer, Decorate decorate, Condition condition,
+                          SubCommand subCommand,
+                          bool hasSlash = false)
+{
+    if (hasSlash)
+        buffer += '/';
+    buffer += "execute ";
+    decorate(buffer);
+    buffer += ' ';
+    condition(buffer);
+    buffer += " run ";
+    subCommand(buffer);
+}
+
+template<typename SubCommand>
+inline void appendExecute(std::string &buffer, Selector as,
+                          SubCommand subCommand,
+                          bool hasSlash = false)
+{
+    appendExecute(buffer, [as](std::string &out) {
+        out += "as ";
+        out += _Selector[static_cast<int>(as)];
+    }, [](std::string &) {}, subCommand, hasSlash);
+}
+
+template<typename SubCommand>
+inline void appendExecute(std::string &buffer, Selector as, Selector at,
+                          SubCommand subCommand,
+                          bool hasSlash = false)
+{
+    appendExecute(buffer, [as, at](std::string &out) {
+        out += "as ";
+        out += _Selector[static_cast<int>(as)];
+        out += " at ";
+        out += _Selector[static_cast<int>(at)];
+    }, [](std::string &) {}, subCommand, hasSlash);
+}
+
+template<typename SubCommand>
+inline void appendExecute(std::string &buffer, Selector as, Selector at,
+                          const std::array<int, 3> &pos,
+                          SubCommand subCommand,
+                          PosMode posMode = PosMode::Absolute,
+                          bool hasSlash = false)
+{
+    appendExecute(buffer, [as, at, &pos, posMode](std::string &out) {
+        out += "as ";
+        out += _Selector[static_cast<int>(as)];
+        out += " at ";
+        out += _Selector[static_cast<int>(at)];
+        out += " positioned ";
+        appendPos(out, pos, posMode);
+    }, [](std::string &) {}, subCommand, hasSlash);
+}
+
+// @brief Gets the callable which writes the string, for the sub command of the appenders.
+inline auto text(const std::string &str) {
+    return [&str](std::string &buffer) {
+        buffer += str;
+    };
+}
+
 inline std::string setblock(const std::string &blockId,
                             const std::array<int, 3> &pos,
                             PosMode posMode = PosMode::Absolute,
@@ -83,13 +282,7 @@ inline std::string setblock(const std::string &blockId,
                             bool hasSlash = false)
 {
     std::string command;
-    if (hasSlash)
-        command = '/';
-    command = command + "setblock" + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[0]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[1]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[2]) + ' ' +
-        blockId + ' ' + _SetblockMode[static_cast<int>(mode)];
+    appendSetblock(command, blockId, pos, posMode, mode, hasSlash);
     return command;
 }
 
@@ -102,19 +295,8 @@ inline std::string fill(const std::string &blockId,
                         bool hasSlash = false)
 {
     std::string command;
-    if (hasSlash)
-        command = '/';
-    command = command + "fill" + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(posFrom[0]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(posFrom[1]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(posFrom[2]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(posTo[0]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(posTo[1]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(posTo[2]) + ' ' +
-        blockId + ' ' + _FillMode[static_cast<int>(mode)];
-    if (replacedBlockId.empty() || mode != FillMode::Replace)
-        return command;
-    return command + ' ' + replacedBlockId;
+    appendFill(command, blockId, posFrom, posTo, posMode, mode, replacedBlockId, hasSlash);
+    return command;
 }
 
 inline std::string particle(const std::string &particleId,
@@ -123,13 +305,7 @@ inline std::string particle(const std::string &particleId,
                             bool hasSlash = false)
 {
     std::string command;
-    if (hasSlash)
-        command = '/';
-    command = command + "particle" + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[0]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[1]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[2]) + ' ' +
-        particleId;
+    appendParticle(command, particleId, pos, posMode, hasSlash);
     return command;
 }
 
@@ -140,14 +316,7 @@ inline std::string oldExecute(const std::string &targetEntityId,
                               bool hasSlash = false)
 {
     std::string command;
-    if (hasSlash)
-        command = '/';
-    command = command + "execute" + ' ' +
-        targetEntityId + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[0]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[1]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[2]) + ' ' +
-        subCommand;
+    appendOldExecute(command, targetEntityId, pos, text(subCommand), posMode, hasSlash);
     return command;
 }
 
@@ -161,19 +330,8 @@ inline std::string oldExecute(const std::string &targetEntityId,
                               bool hasSlash = false)
 {
     std::string command;
-    if (hasSlash)
-        command = '/';
-    command = command + "execute" + ' ' +
-        targetEntityId + ' ' +
-        _PosMode[static_cast<int>(executePosMode)] + std::to_string(executePos[0]) + ' ' +
-        _PosMode[static_cast<int>(executePosMode)] + std::to_string(executePos[1]) + ' ' +
-        _PosMode[static_cast<int>(executePosMode)] + std::to_string(executePos[2]) + ' ' +
-        "detect" + ' ' +
-        _PosMode[static_cast<int>(detectPosMode)] + std::to_string(detectPos[0]) + ' ' +
-        _PosMode[static_cast<int>(detectPosMode)] + std::to_string(detectPos[1]) + ' ' +
-        _PosMode[static_cast<int>(detectPosMode)] + std::to_string(detectPos[2]) + ' ' +
-        blockId + ' ' + std::to_string(data) + ' ' +
-        subCommand;
+    appendOldExecute(command, targetEntityId, executePos, detectPos, blockId, data, text(subCommand),
+                     executePosMode, detectPosMode, hasSlash);
     return command;
 }
 
@@ -182,13 +340,7 @@ inline std::string execute(const std::string &decorate, const std::string &condi
                            bool hasSlash = false)
 {
     std::string command;
-    if (hasSlash)
-        command = '/';
-    command = command + "execute" + ' ' +
-        decorate + ' ' +
-        condition + ' ' +
-        "run" + ' ' +
-        subCommand;
+    appendExecute(command, text(decorate), text(condition), text(subCommand), hasSlash);
     return command;
 }
 
@@ -196,24 +348,18 @@ inline std::string execute(Selector as,
                            const std::string &subCommand,
                            bool hasSlash = false)
 {
-    std::string decorate;
-    decorate = decorate + "as" + ' ' +
-        _Selector[static_cast<int>(as)];
-    std::string condition;
-    return execute(decorate, condition, subCommand, hasSlash);
+    std::string command;
+    appendExecute(command, as, text(subCommand), hasSlash);
+    return command;
 }
 
 inline std::string execute(Selector as, Selector at,
                            const std::string &subCommand,
                            bool hasSlash = false)
 {
-    std::string decorate;
-    decorate = decorate + "as" + ' ' +
-        _Selector[static_cast<int>(as)] + ' ' +
-        "at" + ' ' +
-        _Selector[static_cast<int>(at)];
-    std::string condition;
-    return execute(decorate, condition, subCommand, hasSlash);
+    std::string command;
+    appendExecute(command, as, at, text(subCommand), hasSlash);
+    return command;
 }
 
 inline std::string execute(Selector as, Selector at,
@@ -222,17 +368,9 @@ inline std::string execute(Selector as, Selector at,
                            PosMode posMode = PosMode::Absolute,
                            bool hasSlash = false)
 {
-    std::string decorate;
-    decorate = decorate + "as" + ' ' +
-        _Selector[static_cast<int>(as)] + ' ' +
-        "at" + ' ' +
-        _Selector[static_cast<int>(at)] + ' ' +
-        "positioned" + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[0]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[1]) + ' ' +
-        _PosMode[static_cast<int>(posMode)] + std::to_string(pos[2]);
-    std::string condition;
-    return execute(decorate, condition, subCommand, hasSlash);
+    std::string command;
+    appendExecute(command, as, at, pos, text(subCommand), posMode, hasSlash);
+    return command;
 }
 
 }
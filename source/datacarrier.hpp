@@ -1,8 +1,12 @@
 #ifndef DATACARRIER_HPP
 #define DATACARRIER_HPP
 
+#include <cassert>
+#include <cstdint>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 
 template<typename T>
 struct Pos
@@ -118,30 +122,168 @@ struct BlockCluster
     Posi posTo;
 };
 
-struct BlockCube
+// @brief The unique block ids of a cuboid area, the index 0 is the air block by default.
+struct BlockPalette
 {
-    using String1D = std::vector<std::string>;
-    using String2D = std::vector<String1D>;
-    using String3D = std::vector<String2D>;
+    BlockPalette() :
+        palette(1, "minecraft:air") {}
 
+    // @brief Gets the palette index of the block id, appends it to the palette if it does not exist.
+    std::uint16_t paletteIndex(const std::string &blockId) {
+        auto it = std::find(palette.begin(), palette.end(), blockId);
+        if (it != palette.end())
+            return static_cast<std::uint16_t>(it - palette.begin());
+        assert(palette.size() < 0xFFFF);
+        palette.push_back(blockId);
+        return static_cast<std::uint16_t>(palette.size() - 1);
+    }
+
+    std::vector<std::string> palette;
+};
+
+// @brief The blocks of a cuboid area, stores the palette index of every block in a contiguous grid.
+// @note The grid is x-major, the z is the fastest axis.
+struct BlockCube : BlockPalette
+{
+    BlockCube() {}
     BlockCube(int x, int y, int z) :
-        x(x), y(y), z(z), size(x *y *z)
+        x(x), y(y), z(z), size(static_cast<std::size_t>(x) * y * z), indices(size, 0) {}
+
+    std::size_t strideX() const {
+        return static_cast<std::size_t>(y) * z;
+    }
+    std::size_t strideY() const {
+        return static_cast<std::size_t>(z);
+    }
+    std::size_t strideZ() const {
+        return 1;
+    }
+    std::size_t offset(int x, int y, int z) const {
+        return x * strideX() + y * strideY() + z;
+    }
+
+    std::uint16_t &at(int x, int y, int z) {
+        return indices[offset(x, y, z)];
+    }
+    std::uint16_t at(int x, int y, int z) const {
+        return indices[offset(x, y, z)];
+    }
+    void set(int x, int y, int z, std::uint16_t index) {
+        indices[offset(x, y, z)] = index;
+    }
+    const std::string &blockId(int x, int y, int z) const {
+        return palette[at(x, y, z)];
+    }
+
+    int x = 0;
+    int y = 0;
+    int z = 0;
+    std::size_t size = 0;
+    std::vector<std::uint16_t> indices;
+};
+
+// @brief The blocks of a cuboid area stored in the cubic chunks, a chunk of one block only stores the single value.
+// @note A chunk is allocated when a different block is set to it, compact() collapses the uniform ones back.
+//       The blocks of a chunk are x-major, the edge chunks are clipped by the area.
+struct ChunkedBlockCube : BlockPalette
+{
+    struct Chunk
     {
-        blockIds = String3D(x, String2D(y, String1D(z)));
+        bool isUniform() const {
+            return indices.empty();
+        }
+
+        // The palette index of the blocks, empty if all the blocks are the value.
+        std::vector<std::uint16_t> indices;
+        std::uint16_t value = 0;
+    };
+
+    ChunkedBlockCube() {}
+    ChunkedBlockCube(int x, int y, int z, int chunkSize = 16) :
+        x(x), y(y), z(z), size(static_cast<std::size_t>(x) * y * z), chunkSize(chunkSize),
+        chunkX((x + chunkSize - 1) / chunkSize), chunkY((y + chunkSize - 1) / chunkSize),
+        chunkZ((z + chunkSize - 1) / chunkSize),
+        chunks(static_cast<std::size_t>(chunkX) * chunkY * chunkZ) {}
+
+    std::size_t chunkIndex(int cx, int cy, int cz) const {
+        return (static_cast<std::size_t>(cx) * chunkY + cy) * chunkZ + cz;
+    }
+    const Chunk &chunk(int cx, int cy, int cz) const {
+        return chunks[chunkIndex(cx, cy, cz)];
+    }
+    // @brief Gets the positions range of the chunk which is inside the area, the posTo is inclusive.
+    void chunkBounds(int cx, int cy, int cz, Posi &posFrom, Posi &posTo) const {
+        posFrom = Posi(cx * chunkSize, cy * chunkSize, cz * chunkSize);
+        posTo = Posi(std::min(posFrom.x + chunkSize, x) - 1, std::min(posFrom.y + chunkSize, y) - 1,
+                     std::min(posFrom.z + chunkSize, z) - 1);
     }
 
-    String2D &operator[](int z) {
-        return blockIds[z];
+    std::uint16_t at(int x, int y, int z) const {
+        const Chunk &chunk = chunks[chunkIndex(x / chunkSize, y / chunkSize, z / chunkSize)];
+        if (chunk.isUniform())
+            return chunk.value;
+        return chunk.indices[localOffset(x, y, z)];
     }
-    const String2D &operator[](int z) const {
-        return blockIds[z];
+    void set(int x, int y, int z, std::uint16_t index) {
+        Chunk &chunk = chunks[chunkIndex(x / chunkSize, y / chunkSize, z / chunkSize)];
+        if (chunk.isUniform()) {
+            if (chunk.value == index)
+                return;
+            chunk.indices.assign(static_cast<std::size_t>(chunkExtent(x / chunkSize, this->x)) *
+                                 chunkExtent(y / chunkSize, this->y) * chunkExtent(z / chunkSize, this->z),
+                                 chunk.value);
+        }
+        chunk.indices[localOffset(x, y, z)] = index;
+    }
+    const std::string &blockId(int x, int y, int z) const {
+        return palette[at(x, y, z)];
+    }
+
+    // @brief Collapses the allocated chunks of one block in the chunk layer of cz, -1 means all layers.
+    void compact(int cz = -1) {
+        for (int cx = 0; cx < chunkX; ++cx) {
+            for (int cy = 0; cy < chunkY; ++cy) {
+                for (int i = cz == -1 ? 0 : cz; i < (cz == -1 ? chunkZ : cz + 1); ++i) {
+                    Chunk &chunk = chunks[chunkIndex(cx, cy, i)];
+                    if (chunk.isUniform())
+                        continue;
+                    std::uint16_t value = chunk.indices[0];
+                    if (!std::all_of(chunk.indices.begin(), chunk.indices.end(),
+                                     [value](std::uint16_t v) { return v == value; }))
+                        continue;
+                    chunk.value = value;
+                    std::vector<std::uint16_t>().swap(chunk.indices);
+                }
+            }
+        }
+    }
+
+    // @brief Gets the count of the allocated chunks.
+    int denseChunkCount() const {
+        return static_cast<int>(std::count_if(chunks.begin(), chunks.end(),
+                                              [](const Chunk &chunk) { return !chunk.isUniform(); }));
     }
 
-    String3D blockIds;
-    int size = 0;
     int x = 0;
     int y = 0;
     int z = 0;
+    std::size_t size = 0;
+    int chunkSize = 16;
+    int chunkX = 0;
+    int chunkY = 0;
+    int chunkZ = 0;
+    std::vector<Chunk> chunks;
+
+private:
+    // The allocated size of the edge chunks is clipped by the area.
+    int chunkExtent(int chunkPos, int areaSize) const {
+        return std::min(chunkSize, areaSize - chunkPos * chunkSize);
+    }
+    std::size_t localOffset(int x, int y, int z) const {
+        std::size_t h = chunkExtent(y / chunkSize, this->y);
+        std::size_t d = chunkExtent(z / chunkSize, this->z);
+        return ((x % chunkSize) * h + y % chunkSize) * d + z % chunkSize;
+    }
 };
 
 #endif // !DATACARRIER_HPP
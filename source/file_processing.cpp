@@ -1,22 +1,230 @@
 #include "file_processing.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
 #include <miniz/miniz.h>
 #include <betterfiles.hpp>
 
-void compressFolder(const std::string &srcPath, const std::string &destPath)
-{
-    mz_zip_archive zipArchive;
-    memset(&zipArchive, 0, sizeof(zipArchive));
+#include "parallel.hpp"
+
+// The raw bytes of a deflate batch, it bounds the buffers of the deflated entries.
+constexpr std::size_t _BatchBytes = 64 << 20;
+
+// The entries of a deflate batch per worker.
+constexpr std::size_t _BatchEntriesPerWorker = 4;
+
+static bool hasSuffix(const std::string &str, const std::string &suffix) {
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
 
-    mz_zip_writer_init_file(&zipArchive, destPath.c_str(), 0);
+int ZipLevels::levelOf(const std::string &name, std::size_t size) const {
+    if (storeCompressed && hasSuffix(name, ".png"))
+        return 0;
+    if (largeSize > 0 && size >= largeSize)
+        return largeLevel;
+    return level;
+}
 
+void compressFolder(const std::string &srcPath, const std::string &destPath, const ZipLevels &levels,
+                    int threadCount)
+{
+    ZipWriter zip;
+    if (!zip.open(destPath))
+        return;
+
+    // Reads the files batch by batch, so the folder is not loaded at once.
     std::vector<std::string> files = Bf::getAllFiles(srcPath);
-    for (auto &file : files) {
-        mz_zip_writer_add_file(&zipArchive,
-                               (Bf::getPathSuffix(srcPath) + "/" + file.substr(srcPath.size() + 1)).c_str(),
-                               file.c_str(), NULL, 0, MZ_BEST_COMPRESSION);
+    std::vector<std::string> datas;
+    std::vector<ZipEntry> entries;
+    std::size_t bytes = 0;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        std::ifstream file(files[i], std::ios::binary);
+        std::ostringstream stream;
+        stream << file.rdbuf();
+        datas.push_back(stream.str());
+        bytes += datas.back().size();
+        if (bytes >= _BatchBytes || i + 1 == files.size()) {
+            for (std::size_t j = 0; j < datas.size(); ++j) {
+                const std::string &path = files[i + 1 - datas.size() + j];
+                entries.push_back({ Bf::getPathSuffix(srcPath) + "/" + path.substr(srcPath.size() + 1),
+                                    &datas[j] });
+            }
+            zip.add(entries, levels, threadCount);
+            datas.clear();
+            entries.clear();
+            bytes = 0;
+        }
     }
+    zip.close();
+}
 
-    mz_zip_writer_finalize_archive(&zipArchive);
-    mz_zip_writer_end(&zipArchive);
+struct ZipWriter::Archive
+{
+    mz_zip_archive zip;
+};
+
+// The entry deflated by the worker.
+struct DeflatedEntry
+{
+    DeflatedEntry() {}
+    ~DeflatedEntry() {
+        mz_free(data);
+    }
+
+    DeflatedEntry(const DeflatedEntry &) = delete;
+    DeflatedEntry &operator=(const DeflatedEntry &) = delete;
+
+    // The raw deflate stream, nullptr for the stored entry.
+    void *data = nullptr;
+    std::size_t size = 0;
+    mz_uint32 crc = 0;
+    int level = 0;
+};
+
+// @brief Deflates the data as the zip entry needs, it is stored if the level is 0 or the deflating does not help.
+static void deflateEntry(const std::string &data, int level, DeflatedEntry &entry) {
+    // The zip writer stores the data which is not longer than 3 bytes.
+    if (level <= 0 || data.size() <= 3)
+        return;
+    int flags = static_cast<int>(tdefl_create_comp_flags_from_zip_params(level, -15, MZ_DEFAULT_STRATEGY));
+    entry.data = tdefl_compress_mem_to_heap(data.data(), data.size(), &entry.size, flags);
+    if (entry.data == nullptr || entry.size >= data.size()) {
+        mz_free(entry.data);
+        entry.data = nullptr;
+        return;
+    }
+    entry.level = level;
+    entry.crc = static_cast<mz_uint32>(mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char *>(data.data()),
+                                                data.size()));
+}
+
+ZipWriter::ZipWriter() {}
+
+ZipWriter::~ZipWriter() {
+    close();
+}
+
+bool ZipWriter::open(const std::string &filepath) {
+    close();
+    archive_.reset(new Archive);
+    memset(&archive_->zip, 0, sizeof(archive_->zip));
+    if (!mz_zip_writer_init_file(&archive_->zip, filepath.c_str(), 0)) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Can not create the zip file." <<
+            std::endl;
+        archive_.reset();
+        return false;
+    }
+    return true;
+}
+
+bool ZipWriter::add(const std::string &name, const std::string &data, int level) {
+    if (archive_ == nullptr)
+        return false;
+    return mz_zip_writer_add_mem(&archive_->zip, name.c_str(), data.data(), data.size(),
+                                 static_cast<mz_uint>(level));
+}
+
+bool ZipWriter::add(const std::vector<ZipEntry> &entries, const ZipLevels &levels, int threadCount) {
+    if (archive_ == nullptr)
+        return false;
+    std::size_t workers = static_cast<std::size_t>(workerCount(threadCount));
+    bool isAdded = true;
+    for (std::size_t begin = 0; begin < entries.size();) {
+        std::size_t end = begin;
+        std::size_t bytes = 0;
+        while (end < entries.size() && end - begin < workers * _BatchEntriesPerWorker && bytes < _BatchBytes)
+            bytes += entries[end++].data->size();
+
+        // The entries sizes are very different, so the workers take the next entry when they are free.
+        std::vector<DeflatedEntry> deflated(end - begin);
+        std::atomic<std::size_t> next(begin);
+        int batchWorkers = static_cast<int>(std::min(workers, end - begin));
+        parallelFor(0, batchWorkers, batchWorkers, [&](int, int, int) {
+            for (std::size_t i = next++; i < end; i = next++) {
+                const std::string &data = *entries[i].data;
+                deflateEntry(data, levels.levelOf(entries[i].name, data.size()), deflated[i - begin]);
+            }
+        });
+
+        for (std::size_t i = begin; i < end; ++i) {
+            const std::string &data = *entries[i].data;
+            const DeflatedEntry &entry = deflated[i - begin];
+            bool isEntryAdded = entry.data == nullptr ?
+                mz_zip_writer_add_mem(&archive_->zip, entries[i].name.c_str(), data.data(), data.size(), 0) :
+                mz_zip_writer_add_mem_ex(&archive_->zip, entries[i].name.c_str(), entry.data, entry.size, nullptr,
+                                         0, static_cast<mz_uint>(entry.level) | MZ_ZIP_FLAG_COMPRESSED_DATA,
+                                         data.size(), entry.crc);
+            if (!isEntryAdded) {
+                std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Can not add " <<
+                    entries[i].name << "." << std::endl;
+                isAdded = false;
+            }
+        }
+        begin = end;
+    }
+    return isAdded;
+}
+
+bool ZipWriter::close() {
+    if (archive_ == nullptr)
+        return false;
+    bool isFinalized = mz_zip_writer_finalize_archive(&archive_->zip);
+    mz_zip_writer_end(&archive_->zip);
+    archive_.reset();
+    return isFinalized;
+}
+
+std::vector<ZipBenchmark> benchmarkZip(const std::vector<ZipEntry> &entries, const std::string &filepath,
+                                       int threadCount) {
+    struct Setting
+    {
+        const char *name;
+        ZipLevels levels;
+        bool isSerial;
+    };
+    ZipLevels best;
+    best.largeLevel = best.level;
+    best.storeCompressed = false;
+    ZipLevels fast;
+    fast.level = fast.largeLevel = 1;
+    const Setting settings[] = {
+        { "serial best", best, true },
+        { "parallel best", best, false },
+        { "parallel per entry", ZipLevels(), false },
+        { "parallel fast", fast, false }
+    };
+
+    std::size_t rawSize = 0;
+    for (auto &entry : entries)
+        rawSize += entry.data->size();
+    std::vector<ZipBenchmark> results;
+    for (auto &setting : settings) {
+        ZipBenchmark result;
+        result.setting = setting.name;
+        result.threadCount = setting.isSerial ? 1 : workerCount(threadCount);
+        result.rawSize = rawSize;
+        auto start = std::chrono::steady_clock::now();
+        ZipWriter zip;
+        if (!zip.open(filepath))
+            return results;
+        if (setting.isSerial) {
+            for (auto &entry : entries)
+                zip.add(entry.name, *entry.data, setting.levels.level);
+        }
+        else {
+            zip.add(entries, setting.levels, result.threadCount);
+        }
+        zip.close();
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::error_code error;
+        result.zipSize = static_cast<std::size_t>(std::filesystem::file_size(filepath, error));
+        results.push_back(result);
+    }
+    return results;
 }
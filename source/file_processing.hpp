@@ -1,5 +1,80 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <vector>
 
-void compressFolder(const std::string &srcPath, const std::string &destPath);
+// The deflate levels of the zip entries.
+struct ZipLevels
+{
+    // The level of the ordinary entries, 0 for no compression to 10.
+    int level = 9;
+    // The level of the large entries, they are the .mcstructure files of the videos in practice.
+    int largeLevel = 1;
+    // The size from which the entry is large, in bytes, 0 means no entry is large.
+    std::size_t largeSize = 1 << 20;
+    // Stores the already compressed entries, that is the .png files.
+    bool storeCompressed = true;
+
+    // @brief Gets the level of the entry by its name and size.
+    int levelOf(const std::string &name, std::size_t size) const;
+};
+
+// The entry to add, the data must outlive the adding.
+struct ZipEntry
+{
+    std::string name;
+    const std::string *data = nullptr;
+};
+
+// @param threadCount The deflate worker count, 0 or negative means the hardware concurrency.
+void compressFolder(const std::string &srcPath, const std::string &destPath, const ZipLevels &levels = ZipLevels(),
+                    int threadCount = 0);
+
+// @brief Writes the zip file entry by entry from the memory, no temporary file is needed.
+class ZipWriter
+{
+public:
+    ZipWriter();
+    ~ZipWriter();
+
+    ZipWriter(const ZipWriter &) = delete;
+    ZipWriter &operator=(const ZipWriter &) = delete;
+
+    // @brief Creates the zip file, the opened file will be closed.
+    bool open(const std::string &filepath);
+    // @param name The entry path in the zip, separated by '/'.
+    // @param level The deflate level, 0 for no compression to 10.
+    bool add(const std::string &name, const std::string &data, int level = 9);
+    // @brief Deflates the entries on the workers into the separate buffers, then appends them in order.
+    // @param threadCount The worker count, 0 or negative means the hardware concurrency.
+    // @note The entries are deflated batch by batch, so the buffers are bounded for the large packs.
+    bool add(const std::vector<ZipEntry> &entries, const ZipLevels &levels, int threadCount = 0);
+    // @brief Writes the central directory and closes the file.
+    bool close();
+
+private:
+    struct Archive;
+    std::unique_ptr<Archive> archive_;
+};
+
+// The compression result of a level setting.
+struct ZipBenchmark
+{
+    std::string setting;
+    int threadCount = 0;
+    std::size_t rawSize = 0;
+    std::size_t zipSize = 0;
+    double seconds = 0;
+
+    // @brief The zip size to the raw size.
+    double ratio() const {
+        return rawSize > 0 ? static_cast<double>(zipSize) / rawSize : 0;
+    }
+};
+
+// @brief Writes the entries to the zip file with each setting, the file is overwritten every time.
+// @note The first setting is the single thread best compression, which is the old way.
+std::vector<ZipBenchmark> benchmarkZip(const std::vector<ZipEntry> &entries, const std::string &filepath,
+                                       int threadCount = 0);
@@ -0,0 +1,85 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // _WIN32
+
+bool MappedFile::open(const std::string &filepath) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+    file_ = file;
+    isOpen_ = true;
+    if (fileSize.QuadPart == 0)
+        return true;
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        close();
+        return false;
+    }
+    mapping_ = mapping;
+    data_ = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+        close();
+        return false;
+    }
+    size_ = static_cast<std::size_t>(fileSize.QuadPart);
+    return true;
+#else
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    isOpen_ = true;
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+    void *addr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference of the file.
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        isOpen_ = false;
+        return false;
+    }
+    data_ = static_cast<const char *>(addr);
+    size_ = static_cast<std::size_t>(st.st_size);
+    return true;
+#endif // _WIN32
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (data_ != nullptr)
+        UnmapViewOfFile(data_);
+    if (mapping_ != nullptr)
+        CloseHandle(static_cast<HANDLE>(mapping_));
+    if (file_ != nullptr)
+        CloseHandle(static_cast<HANDLE>(file_));
+    mapping_ = nullptr;
+    file_ = nullptr;
+#else
+    if (data_ != nullptr)
+        munmap(const_cast<char *>(data_), size_);
+#endif // _WIN32
+    data_ = nullptr;
+    size_ = 0;
+    isOpen_ = false;
+}
@@ -0,0 +1,48 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+// @brief A read only memory mapping of the whole file.
+// @note The mapping is released when the object is destroyed, so the data pointer must not outlive it.
+class MappedFile
+{
+public:
+    MappedFile() {}
+    explicit MappedFile(const std::string &filepath) {
+        open(filepath);
+    }
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // @brief Maps the file, the previous mapping will be released.
+    // @return Whether the file is mapped, an empty file is mapped with the null data.
+    bool open(const std::string &filepath);
+    void close();
+
+    bool isOpen() const {
+        return isOpen_;
+    }
+    const char *data() const {
+        return data_;
+    }
+    std::size_t size() const {
+        return size_;
+    }
+
+private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+    bool isOpen_ = false;
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif // _WIN32
+};
+
+#endif // !MAPPED_FILE_HPP
@@ -123,4 +123,38 @@ Bf::Dir getMcpackFrame(const PackManifest &manifest) {
     return root;
 }
 
+PackDir::PackDir(const PackManifest &manifest) : root_(getMcpackFrame(manifest)) {
+    for (const char *path : { "manifest.json", "pack_icon.png", "functions/tick.json" }) {
+        files_.push_back(path);
+        fileSet_.insert(path);
+    }
+}
+
+Bf::File &PackDir::file(const std::string &path) {
+    if (fileSet_.insert(path).second)
+        files_.push_back(path);
+    Bf::Dir *dir = &root_;
+    std::size_t begin = 0;
+    std::size_t end = path.find('/');
+    for (; end != std::string::npos; begin = end + 1, end = path.find('/', begin))
+        dir = &(*dir)[path.substr(begin, end - begin)];
+    return (*dir)(path.substr(begin));
+}
+
+void PackDir::write(const std::string &outputPath, bool isCompress, const ZipLevels &levels, int threadCount) {
+    if (!isCompress) {
+        root_.write(outputPath, Bf::Override);
+        return;
+    }
+    ZipWriter zip;
+    if (!zip.open(outputPath + "/" + root_.name() + ".mcpack"))
+        return;
+    std::vector<ZipEntry> entries;
+    entries.reserve(files_.size());
+    for (auto &path : files_)
+        entries.push_back({ root_.name() + "/" + path, &file(path).data() });
+    zip.add(entries, levels, threadCount);
+    zip.close();
+}
+
 }
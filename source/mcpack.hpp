@@ -5,9 +5,13 @@
 #include <string>
 #include <sstream>
 #include <random>
+#include <unordered_set>
+#include <vector>
 
 #include <betterfiles.hpp>
 
+#include "file_processing.hpp"
+
 namespace Mcpack
 {
 
@@ -55,6 +59,36 @@ std::string getManifestJson(const PackManifest &manifest);
 
 Bf::Dir getMcpackFrame(const PackManifest &manifest);
 
+// @brief The pack directory in the memory, it records the paths of its files, so it can be compressed from the
+//        memory without writing the directory.
+class PackDir
+{
+public:
+    explicit PackDir(const PackManifest &manifest);
+
+    // @brief Gets the file of the path, the missing directories and file are created.
+    // @param path The path relative to the pack directory, separated by '/'.
+    Bf::File &file(const std::string &path);
+
+    Bf::Dir &root() {
+        return root_;
+    }
+    // @brief The paths of the files, in the order of creation.
+    const std::vector<std::string> &files() const {
+        return files_;
+    }
+
+    // @brief Writes the pack directory into the output directory, or the .mcpack file if it is compressed.
+    // @param threadCount The deflate worker count, 0 or negative means the hardware concurrency.
+    void write(const std::string &outputPath, bool isCompress, const ZipLevels &levels = ZipLevels(),
+               int threadCount = 0);
+
+private:
+    Bf::Dir root_;
+    std::vector<std::string> files_;
+    std::unordered_set<std::string> fileSet_;
+};
+
 }
 
 #endif // !MCPACK_HPP
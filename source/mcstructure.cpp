@@ -0,0 +1,42 @@
+#include "mcstructure.hpp"
+
+namespace Mcstructure
+{
+
+void writeHead(NbtWriter &writer, int xs, int ys, int zs) {
+    writer.beginCompound("");
+    writer.writeInt("format_version", 1);
+    writer.beginList("size", Int, 3);
+    writer.writeIntPayload(xs);
+    writer.writeIntPayload(ys);
+    writer.writeIntPayload(zs);
+    writer.beginCompound("structure");
+    writer.beginList("block_indices", List, 2);
+}
+
+void writeTail(NbtWriter &writer, const std::vector<const std::string *> &palette) {
+    writer.beginList("entities", End, 0);
+    writer.beginCompound("palette");
+    writer.beginCompound("default");
+    writer.beginCompound("block_position_data");
+    writer.endCompound();
+    writer.beginList("block_palette", Compound, static_cast<int>(palette.size()));
+    for (const std::string *blockId : palette) {
+        writer.beginCompound("states");
+        writer.endCompound();
+        writer.writeInt("version", _BlockVersion);
+        writer.writeString("name", *blockId);
+        writer.endCompound();
+    }
+    // End the default, palette and structure.
+    writer.endCompound();
+    writer.endCompound();
+    writer.endCompound();
+    writer.beginList("structure_world_origin", Int, 3);
+    writer.writeIntPayload(0);
+    writer.writeIntPayload(0);
+    writer.writeIntPayload(0);
+    writer.endCompound();
+}
+
+}
@@ -0,0 +1,149 @@
+#ifndef MCSTRUCTURE_HPP
+#define MCSTRUCTURE_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace Mcstructure
+{
+
+// The tag types of NBT.
+enum TagType : char
+{
+    End,
+    Byte,
+    Short,
+    Int,
+    Long,
+    Float,
+    Double,
+    ByteArray,
+    String,
+    List,
+    Compound
+};
+
+// The block version of the palette entries.
+constexpr int _BlockVersion = 18103297;
+
+// @brief Appends the little-endian NBT of the Bedrock Edition to the buffer.
+// @note Only writes the tags, the caller keeps the nesting right.
+class NbtWriter
+{
+public:
+    explicit NbtWriter(std::string &buffer) : buffer_(buffer) {}
+
+    void beginCompound(const std::string &name) {
+        writeHeader(Compound, name);
+    }
+    void endCompound() {
+        buffer_ += static_cast<char>(End);
+    }
+    // @brief Begins the named list, the count elements payload must follow.
+    void beginList(const std::string &name, TagType elementType, int count) {
+        writeHeader(List, name);
+        writeListPayloadHeader(elementType, count);
+    }
+    // @brief Begins the list which is an element of a list.
+    void writeListPayloadHeader(TagType elementType, int count) {
+        buffer_ += static_cast<char>(elementType);
+        writeIntPayload(count);
+    }
+    void writeInt(const std::string &name, int value) {
+        writeHeader(Int, name);
+        writeIntPayload(value);
+    }
+    void writeString(const std::string &name, const std::string &value) {
+        writeHeader(String, name);
+        writeStringPayload(value);
+    }
+
+    void writeIntPayload(int value) {
+        char bytes[4];
+        storeInt(bytes, value);
+        buffer_.append(bytes, 4);
+    }
+    void writeStringPayload(const std::string &value) {
+        std::uint16_t length = static_cast<std::uint16_t>(value.size());
+        buffer_ += static_cast<char>(length & 0xff);
+        buffer_ += static_cast<char>(length >> 8);
+        buffer_.append(value, 0, length);
+    }
+
+    // @brief Stores the int in little-endian.
+    static void storeInt(char *dest, int value) {
+        std::uint32_t bits = static_cast<std::uint32_t>(value);
+        dest[0] = static_cast<char>(bits & 0xff);
+        dest[1] = static_cast<char>((bits >> 8) & 0xff);
+        dest[2] = static_cast<char>((bits >> 16) & 0xff);
+        dest[3] = static_cast<char>(bits >> 24);
+    }
+
+private:
+    void writeHeader(TagType type, const std::string &name) {
+        buffer_ += static_cast<char>(type);
+        writeStringPayload(name);
+    }
+
+    std::string &buffer_;
+};
+
+// @brief Writes the tags before the block indices, the size is the structure size.
+void writeHead(NbtWriter &writer, int xs, int ys, int zs);
+
+// @brief Writes the tags after the block indices, the palette is the block ids in the structure palette order.
+void writeTail(NbtWriter &writer, const std::vector<const std::string *> &palette);
+
+// @brief Writes the mcstructure file into the buffer without building the tag tree.
+// @param palette The block ids of the source palette.
+// @param blockAt Gets the source palette index of the structure position (x, y, z).
+// @note The structure palette only has the used blocks, in the order of first appearance, and the positions are
+//       visited in the order of the file, that is x-major and z fastest.
+// @return false if the blocks are more than the length of a NBT list, nothing is written then.
+template<typename BlockAt>
+bool write(std::string &buffer, int xs, int ys, int zs, const std::vector<std::string> &palette, BlockAt blockAt) {
+    std::size_t count = static_cast<std::size_t>(xs) * ys * zs;
+    if (count > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "The structure is too large." <<
+            std::endl;
+        return false;
+    }
+    NbtWriter writer(buffer);
+    buffer.reserve(buffer.size() + count * 8 + 256 + palette.size() * 64);
+    writeHead(writer, xs, ys, zs);
+
+    // The primary layer, which is the structure palette index of every block.
+    writer.writeListPayloadHeader(Int, static_cast<int>(count));
+    std::size_t offset = buffer.size();
+    buffer.resize(offset + count * 4);
+    char *dest = &buffer[0] + offset;
+    std::vector<int> map(palette.size(), -1);
+    std::vector<const std::string *> used;
+    for (int x = 0; x < xs; ++x) {
+        for (int y = 0; y < ys; ++y) {
+            for (int z = 0; z < zs; ++z) {
+                std::uint16_t index = blockAt(x, y, z);
+                if (map[index] == -1) {
+                    map[index] = static_cast<int>(used.size());
+                    used.push_back(&palette[index]);
+                }
+                NbtWriter::storeInt(dest, map[index]);
+                dest += 4;
+            }
+        }
+    }
+
+    // The secondary layer, no block has the waterlogging.
+    writer.writeListPayloadHeader(Int, static_cast<int>(count));
+    buffer.append(count * 4, static_cast<char>(0xff));
+
+    writeTail(writer, used);
+    return true;
+}
+
+}
+
+#endif // !MCSTRUCTURE_HPP
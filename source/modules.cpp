@@ -2,8 +2,15 @@
 
 #include <vector>
 #include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <optional>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 
 #include <opencv2/opencv.hpp>
@@ -12,28 +19,23 @@
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/prettywriter.h>
-#include <nbt.hpp>
 
 #include "datacarrier.hpp"
 #include "command.hpp"
 #include "file_processing.hpp"
+#include "parallel.hpp"
+#include "mcstructure.hpp"
+#include "texture_atlas.hpp"
 
 #undef GetObject
 
+// The capacity of the queues between the video pipeline stages.
+constexpr std::size_t _PipelineQueueSize = 4;
+
 static inline double rgbDistance(const Rgb &a, const Rgb &b) {
     return  std::sqrt(square(a.r - b.r) + square(a.g - b.g) + square(a.b - b.b));
 }
 
-static inline double rgbSimilarity(const Rgb &a, const Rgb &b, int type) {
-    if (type == 0)
-        return 1. - (square<double>(a.r - b.r) * 0.32 + square<double>(a.g - b.g) * 0.52 +
-                     square<double>(a.b - b.b) * 0.16) / 65025;
-    if (type == 1)
-        return 1. - (square<double>(a.r - b.r) * 0.299 + square<double>(a.g - b.g) * 0.587 +
-                     square<double>(a.b - b.b) * 0.114) / 65025;
-    return 0;
-}
-
 static inline Rgb bgrToRgb(const cv::Vec3b &cvBgr) {
     return Rgb(cvBgr[2], cvBgr[1], cvBgr[0]);
 }
@@ -78,21 +80,108 @@ static std::string domToStr(const rapidjson::Document &dom) {
     return buffer.GetString();
 }
 
-static BlockInfoModified *rgbNearest(const Rgb &rgb, BIModis &modis, int type = 0) {
-    assert(!modis.empty());
+// The colors and the results of the previous image, the pixels whose colors are close reuse the results.
+// @note The cached color is only updated when the pixel is searched again, so a slowly changing pixel can not
+//       drift farther than the tolerance from the color of its result.
+struct TemporalCache
+{
+    // @param tolerance The max difference of a color channel to reuse the result, negative means no reuse.
+    explicit TemporalCache(int tolerance) : tolerance(tolerance) {}
 
-    if (modis.empty())
-        return nullptr;
-    BlockInfoModified *result = nullptr;
-    double similarity = 0;
-    for (auto &var : modis) {
-        double sim = rgbSimilarity(rgb, var.color, type);
-        if (similarity > sim)
-            continue;
-        similarity = sim;
-        result = &var;
+    bool isEnabled() const {
+        return tolerance >= 0;
+    }
+    bool isClose(const Rgb &a, const Rgb &b) const {
+        return std::abs(a.r - b.r) <= tolerance && std::abs(a.g - b.g) <= tolerance &&
+            std::abs(a.b - b.b) <= tolerance;
+    }
+    // @brief Adds the counters to the statistics.
+    void addTo(ConvertStats *stats) const {
+        if (stats == nullptr)
+            return;
+        stats->cacheLookups += lookups;
+        stats->cacheHits += hits;
+    }
+
+    int tolerance = -1;
+    int rows = 0;
+    int cols = 0;
+    std::vector<Rgb> colors;
+    std::vector<int> indices;
+    std::size_t lookups = 0;
+    std::size_t hits = 0;
+};
+
+// @brief Maps every pixel of the image to the palette index and calls func(row, col, index) on the workers.
+// @param counts If not null, adds the used count of every palette entry to it.
+// @note The rows are split to the workers, the func must only write the data of its own pixel.
+// @param cache If not null, the pixels reuse the results of the previous image in the cache, and update it.
+template<typename Func>
+static void mapPixels(const cv::Mat &img, const Quantizer::Matcher &matcher, int threadCount,
+                      std::vector<int> *counts, TemporalCache *cache, Func func)
+{
+    const int paletteSize = static_cast<int>(matcher.modis().size());
+    std::vector<std::vector<int>> workerCounts(workerCount(threadCount));
+    std::vector<std::size_t> workerHits(workerCounts.size(), 0);
+    bool isCacheValid = cache != nullptr && cache->rows == img.rows && cache->cols == img.cols;
+    if (cache != nullptr && !isCacheValid) {
+        cache->rows = img.rows;
+        cache->cols = img.cols;
+        cache->colors.assign(static_cast<std::size_t>(img.rows) * img.cols, Rgb());
+        cache->indices.assign(static_cast<std::size_t>(img.rows) * img.cols, 0);
+    }
+    parallelFor(0, img.rows, threadCount, [&](int begin, int end, int worker) {
+        std::vector<int> &localCounts = workerCounts[worker];
+        if (counts != nullptr)
+            localCounts.assign(paletteSize, 0);
+        for (int row = begin; row < end; ++row) {
+            const cv::Vec3b *pixels = img.ptr<cv::Vec3b>(row);
+            for (int col = 0; col < img.cols; ++col) {
+                Rgb rgb = bgrToRgb(pixels[col]);
+                int index = 0;
+                if (cache == nullptr) {
+                    index = matcher.nearest(rgb);
+                } else {
+                    std::size_t i = static_cast<std::size_t>(row) * img.cols + col;
+                    if (isCacheValid && cache->isClose(cache->colors[i], rgb)) {
+                        index = cache->indices[i];
+                        ++workerHits[worker];
+                    } else {
+                        index = matcher.nearest(rgb);
+                        cache->colors[i] = rgb;
+                        cache->indices[i] = index;
+                    }
+                }
+                func(row, col, index);
+                if (counts != nullptr)
+                    ++localCounts[index];
+            }
+        }
+    });
+    if (cache != nullptr) {
+        cache->lookups += static_cast<std::size_t>(img.rows) * img.cols;
+        for (std::size_t hits : workerHits)
+            cache->hits += hits;
+    }
+    if (counts == nullptr)
+        return;
+    counts->resize(paletteSize, 0);
+    for (auto &localCounts : workerCounts) {
+        for (int i = 0; i < static_cast<int>(localCounts.size()); ++i)
+            (*counts)[i] += localCounts[i];
+    }
+}
+
+// @brief Adds the used count of every palette entry to the blocks info.
+static void addBlocksInfo(const std::vector<int> &counts, const Quantizer::Matcher &matcher,
+                          std::unordered_map<std::string, int> *blocksInfo)
+{
+    if (blocksInfo == nullptr)
+        return;
+    for (int i = 0; i < static_cast<int>(counts.size()); ++i) {
+        if (counts[i] != 0)
+            (*blocksInfo)[matcher[i].blockId] += counts[i];
     }
-    return result;
 }
 
 static rapidjson::Document getDom(std::ifstream &dataFile) {
@@ -107,295 +196,643 @@ static rapidjson::Document getDom(std::ifstream &dataFile) {
     return dom;
 }
 
-static BlockCube getBlocks(cv::Mat &img, BIModis &modis, int maxWidth, int maxHeight,
-                           std::unordered_map<std::string, int> *blocksInfo = nullptr)
+// @brief Gets the cube palette index of every palette entry.
+static std::vector<std::uint16_t> internPalette(BlockPalette &blocks, const Quantizer::Matcher &matcher) {
+    std::vector<std::uint16_t> result;
+    result.reserve(matcher.modis().size());
+    for (auto &var : matcher.modis())
+        result.push_back(blocks.paletteIndex(var.blockId));
+    return result;
+}
+
+static void resetCube(BlockCube &blocks, int x, int y, int z, int) {
+    blocks = BlockCube(x, y, z);
+}
+
+static void resetCube(ChunkedBlockCube &blocks, int x, int y, int z, int chunkSize) {
+    blocks = ChunkedBlockCube(x, y, z, chunkSize > 0 ? chunkSize : 16);
+}
+
+static void compactLayer(BlockCube &, int, bool) {}
+
+// @brief Collapses the chunk layer of z when z is the last of the layer or the last of the cube.
+static void compactLayer(ChunkedBlockCube &blocks, int z, bool isLast) {
+    if ((z + 1) % blocks.chunkSize == 0 || isLast)
+        blocks.compact(z / blocks.chunkSize);
+}
+
+// @brief Maps the image to the blocks of the z layer, the image row 0 is the top.
+template<typename Cube>
+static void setLayer(Cube &blocks, int z, const cv::Mat &img, const Quantizer::Matcher &matcher,
+                     const std::vector<std::uint16_t> &palette, std::vector<int> *counts, int threadCount,
+                     TemporalCache *cache)
+{
+    std::vector<std::uint16_t> layer(static_cast<std::size_t>(img.rows) * img.cols);
+    mapPixels(img, matcher, threadCount, counts, cache, [&](int row, int col, int index) {
+        layer[static_cast<std::size_t>(col) * img.rows + img.rows - 1 - row] = palette[index];
+    });
+    // The chunked cube allocates the chunks when setting, so it is done on one thread.
+    for (int x = 0; x < img.cols; ++x) {
+        for (int y = 0; y < img.rows; ++y)
+            blocks.set(x, y, z, layer[static_cast<std::size_t>(x) * img.rows + y]);
+    }
+}
+
+template<typename Cube = BlockCube>
+static Cube getBlocks(cv::Mat &img, const Quantizer::Matcher &matcher, int maxWidth, int maxHeight,
+                      std::unordered_map<std::string, int> *blocksInfo = nullptr, int threadCount = 0,
+                      int chunkSize = 0, TemporalCache *cache = nullptr)
 {
     limitScale(img, maxWidth, maxHeight);
     cv::flip(img, img, 1);
-    BlockCube result(img.cols, img.rows, 1);
-    for (int row = 0; row < img.rows; ++row) {
-        for (int col = 0; col < img.cols; ++col) {
-            Rgb rgb = bgrToRgb(img.at<cv::Vec3b>(row, col));
-            BlockInfoModified *modi = rgbNearest(rgb, modis);
-            result[col][img.rows - 1 - row][0] = modi->blockId;
-            if (blocksInfo != nullptr) {
-                if (blocksInfo->find(modi->blockId) == blocksInfo->end())
-                    blocksInfo->insert({ modi->blockId, 0 });
-                else
-                    ++blocksInfo->at(modi->blockId);
-            }
-        }
-    }
+    Cube result;
+    resetCube(result, img.cols, img.rows, 1, chunkSize);
+    std::vector<std::uint16_t> palette = internPalette(result, matcher);
+    std::vector<int> counts;
+    setLayer(result, 0, img, matcher, palette, blocksInfo != nullptr ? &counts : nullptr, threadCount, cache);
+    compactLayer(result, 0, true);
+    addBlocksInfo(counts, matcher, blocksInfo);
     return result;
 }
 
-static BlockCube getBlocks(cv::VideoCapture &video, BIModis &modis, int maxWidth, int maxHeight,
-                           int maxFrameCount, std::unordered_map<std::string, int> *blocksInfo = nullptr)
+// The frames gap that the sampler seeks instead of grabbing the frames one by one.
+constexpr int _SeekThreshold = 64;
+
+// @brief Reads the frames of the video evenly at the target frame rate in the time range of the options.
+// @note The skipped frames are grabbed without decoding, the far frames are reached by seeking.
+class FrameSampler
 {
-    BlockCube result(0, 0, 0);
-    maxFrameCount = static_cast<int>(video.get(cv::CAP_PROP_FRAME_COUNT)) > maxFrameCount ?
-        maxFrameCount : static_cast<int>(video.get(cv::CAP_PROP_FRAME_COUNT));
+public:
+    FrameSampler(cv::VideoCapture &video, int maxFrameCount, const ConvertOptions &options) : video_(video) {
+        int sourceCount = static_cast<int>(video.get(cv::CAP_PROP_FRAME_COUNT));
+        double fps = video.get(cv::CAP_PROP_FPS);
+        bool hasTime = fps > 0;
+        first_ = hasTime ? static_cast<int>(std::lround(std::max(options.startTime, 0.) * fps)) : 0;
+        int last = sourceCount;
+        if (hasTime && options.endTime > 0)
+            last = std::min(last, static_cast<int>(std::lround(options.endTime * fps)));
+        // A target above the source rate reads every source frame once, the frames are not repeated.
+        step_ = hasTime && options.targetFps > 0 ? std::max(1., fps / options.targetFps) : 1.;
+        frameCount_ = last > first_ ? static_cast<int>(std::ceil((last - first_) / step_ - 1e-9)) : 0;
+        frameCount_ = std::min(frameCount_, maxFrameCount);
+    }
+
+    // @brief The count of the frames to read, it is less if the video ends early.
+    int frameCount() const {
+        return frameCount_;
+    }
+
+    bool read(cv::Mat &frame) {
+        if (index_ >= frameCount_)
+            return false;
+        int target = first_ + static_cast<int>(std::lround(index_ * step_));
+        ++index_;
+        if (target - position_ > _SeekThreshold) {
+            video_.set(cv::CAP_PROP_POS_FRAMES, target);
+            position_ = target;
+        }
+        for (; position_ < target; ++position_) {
+            if (!video_.grab())
+                return false;
+        }
+        ++position_;
+        return video_.read(frame);
+    }
+
+private:
+    cv::VideoCapture &video_;
+    // The source frame index of the next frame to read.
+    int position_ = 0;
+    int first_ = 0;
+    // The source frames per output frame.
+    double step_ = 1;
+    int index_ = 0;
+    int frameCount_ = 0;
+};
+
+// @brief Stacks the frames along z.
+// @param chunkSize The chunk size if the cube is chunked.
+// @param cache If not null, the frames reuse the results of the previous frame in the cache.
+template<typename Cube = BlockCube>
+static Cube getBlocks(FrameSampler &sampler, const Quantizer::Matcher &matcher, int maxWidth, int maxHeight,
+                      std::unordered_map<std::string, int> *blocksInfo = nullptr,
+                      int threadCount = 0, int chunkSize = 0, TemporalCache *cache = nullptr)
+{
+    Cube result;
+    int maxFrameCount = sampler.frameCount();
     cv::Mat frame;
+    std::vector<std::uint16_t> palette;
+    std::vector<int> counts;
     int z = 0;
-    while (video.read(frame)) {
+    while (z < maxFrameCount && sampler.read(frame)) {
         limitScale(frame, maxWidth, maxHeight);
         cv::flip(frame, frame, 1);
-        if (z == 0)
-            result = BlockCube(frame.cols, frame.rows, maxFrameCount);
-        for (int row = 0; row < frame.rows; ++row) {
-            for (int col = 0; col < frame.cols; ++col) {
-                Rgb rgb = bgrToRgb(frame.at<cv::Vec3b>(row, col));
-                BlockInfoModified *modi = rgbNearest(rgb, modis);
-                result[col][frame.rows - 1 - row][z] = modi->blockId;
-                if (blocksInfo != nullptr) {
-                    if (blocksInfo->find(modi->blockId) == blocksInfo->end())
-                        blocksInfo->insert({ modi->blockId, 0 });
-                    else
-                        ++blocksInfo->at(modi->blockId);
-                }
-            }
+        if (z == 0) {
+            resetCube(result, frame.cols, frame.rows, maxFrameCount, chunkSize);
+            palette = internPalette(result, matcher);
         }
+        setLayer(result, z, frame, matcher, palette, blocksInfo != nullptr ? &counts : nullptr, threadCount,
+                 cache);
+        // Collapse the finished chunk layer, so the uniform chunks do not stay allocated.
+        compactLayer(result, z, z + 1 == maxFrameCount);
         if (++z == maxFrameCount)
             break;
     }
+    if (z > 0 && z < maxFrameCount)
+        compactLayer(result, z - 1, true);
+    addBlocksInfo(counts, matcher, blocksInfo);
     return result;
 }
 
-static cv::Mat getBlockImage(cv::Mat &img, BIModis &modis, const std::string &texturePath,
-                             int maxWidth, int maxHeight, std::unordered_map<std::string, int> *blocksInfo = nullptr)
+// @brief Maps the image to the palette indices, the indices are row-major.
+// @return False if the image or the palette is invalid.
+static bool getBlockIndices(cv::Mat &img, const Quantizer::Matcher &matcher, int maxWidth, int maxHeight,
+                            std::unordered_map<std::string, int> *blocksInfo, int threadCount,
+                            std::vector<int> &indices)
 {
-    if (modis.empty() || img.empty() || img.type() != CV_8UC3)
-        return cv::Mat();
+    if (matcher.modis().empty() || img.empty() || img.type() != CV_8UC3)
+        return false;
     if (maxWidth != 0 && maxHeight != 0)
         limitScale(img, maxWidth, maxHeight);
-    std::unordered_map<std::string, cv::Mat *> map;
-    cv::Mat result(img.rows * 16, img.cols * 16, CV_8UC3);
-    for (int row = 0; row < img.rows; ++row) {
-        for (int col = 0; col < img.cols; ++col) {
-            Rgb rgb = bgrToRgb(img.at<cv::Vec3b>(row, col));
-            BlockInfoModified *modi = rgbNearest(rgb, modis);
-            if (map.find(modi->textureName) == map.end()) {
-                cv::Mat *img = new cv::Mat(cv::imread(texturePath + "/" + modi->textureName));
-                map.insert({ modi->textureName, img });
-                img->copyTo(result(cv::Range(row * 16, row * 16 + 16), cv::Range(col * 16, col * 16 + 16)));
-            } else {
-                map[modi->textureName]->copyTo(result(cv::Range(row * 16, row * 16 + 16),
-                                                      cv::Range(col * 16, col * 16 + 16)));
-            }
-            if (blocksInfo != nullptr) {
-                if (blocksInfo->find(modi->blockId) == blocksInfo->end())
-                    blocksInfo->insert({ modi->blockId, 0 });
-                else
-                    ++blocksInfo->at(modi->blockId);
+    indices.assign(static_cast<std::size_t>(img.rows) * img.cols, 0);
+    std::vector<int> counts;
+    mapPixels(img, matcher, threadCount, blocksInfo != nullptr ? &counts : nullptr, nullptr,
+              [&](int row, int col, int index) {
+        indices[static_cast<std::size_t>(row) * img.cols + col] = index;
+    });
+    addBlocksInfo(counts, matcher, blocksInfo);
+    return true;
+}
+
+// @brief Renders the region of the block image, every block takes a texture tile.
+// @param cols The columns of the indices.
+// @param region The region in the pixels of the block image.
+// @note The workers render the rows, every row copies the contiguous tile rows.
+static cv::Mat renderBlocks(const std::vector<int> &indices, int cols, const TextureAtlas &atlas,
+                            const cv::Rect &region, int threadCount)
+{
+    const int tileSize = atlas.tileSize();
+    cv::Mat result(region.height, region.width, CV_8UC3);
+    parallelFor(0, region.height, threadCount, [&](int begin, int end, int) {
+        for (int row = begin; row < end; ++row) {
+            int y = region.y + row;
+            const int *rowIndices = indices.data() + static_cast<std::size_t>(y / tileSize) * cols;
+            unsigned char *dest = result.ptr<unsigned char>(row);
+            for (int x = region.x; x < region.x + region.width;) {
+                int tileX = x % tileSize;
+                int count = std::min(tileSize - tileX, region.x + region.width - x);
+                std::memcpy(dest, atlas.row(rowIndices[x / tileSize], y % tileSize) + tileX * 3,
+                            static_cast<std::size_t>(count) * 3);
+                dest += static_cast<std::size_t>(count) * 3;
+                x += count;
             }
         }
-    }
+    });
     return result;
 }
 
-static std::vector<std::string> getCommands(const BlockCube &blocks, Plane plane,
-                                            bool useNewExecute = true, const Posli &offset = Posli(0, 0, 1))
+// @brief Renders the region of the block image which is scaled down by the factor.
+// @param region The region in the pixels of the scaled image.
+// @note When a block is smaller than a pixel, the blocks take the average color of the textures, so the source of
+//       the scaling is never larger than the blocks or a tile of the full size.
+static cv::Mat renderScaledBlocks(const std::vector<int> &indices, int cols, int rows, const TextureAtlas &atlas,
+                                  const cv::Rect &region, int factor)
 {
-    using namespace Command;
-    std::vector<std::string> commands;
-
-    for (int z = 0; z < blocks.z; ++z) {
-        for (int y = 0; y < blocks.y; ++y) {
-            int x = 0;
-            BlockCluster cluster;
-            cluster.blockId = blocks[x][y][z];
-            cluster.posFrom = Posi(x, y, z);
-            for (; x < blocks.x; ++x) {
-                if (blocks[x][y][z] != cluster.blockId || x == blocks.x - 1) {
-                    int count = x == blocks.x - 1 ? 2 : 1;
-                    for (int i = 0; i < count; ++i) {
-                        switch (plane) {
-                            case XY_Z:
-                                break;
-                            case ZY_X:
-                                std::swap(cluster.posFrom.x, cluster.posFrom.z);
-                                std::swap(cluster.posTo.x, cluster.posTo.z);
-                                break;
-                            case XZ_Y:
-                                std::swap(cluster.posFrom.z, cluster.posFrom.y);
-                                std::swap(cluster.posTo.y, cluster.posTo.y);
-                                break;
-                            default:
-                                break;
-                        }
-                        commands.push_back(execute(Selector::Nearest, Selector::Own,
-                                                   fill(cluster.blockId,
-                                                        { cluster.posFrom.x, cluster.posFrom.y, cluster.posFrom.z },
-                                                        {cluster.posTo.x, cluster.posTo.y, cluster.posTo.z },
-                                                        PosMode::Relative)));
-                        cluster.blockId = blocks[x][y][z];
-                        cluster.posFrom = Posi(x, y, z);
-                        cluster.posTo = Posi(x, y, z);
-                    }
-                }
-                cluster.posTo = Posi(x, y, z);
-            }
+    const int tileSize = atlas.tileSize();
+    int width = cols * tileSize;
+    int height = rows * tileSize;
+    int x0 = region.x * factor;
+    int y0 = region.y * factor;
+    int x1 = std::min(width, (region.x + region.width) * factor);
+    int y1 = std::min(height, (region.y + region.height) * factor);
+    cv::Mat source;
+    if (factor <= tileSize) {
+        source = renderBlocks(indices, cols, atlas, cv::Rect(x0, y0, x1 - x0, y1 - y0), 1);
+    } else {
+        int col0 = x0 / tileSize;
+        int row0 = y0 / tileSize;
+        int col1 = (x1 + tileSize - 1) / tileSize;
+        int row1 = (y1 + tileSize - 1) / tileSize;
+        source.create(row1 - row0, col1 - col0, CV_8UC3);
+        for (int row = row0; row < row1; ++row) {
+            unsigned char *dest = source.ptr<unsigned char>(row - row0);
+            for (int col = col0; col < col1; ++col, dest += 3)
+                std::memcpy(dest, atlas.mean(indices[static_cast<std::size_t>(row) * cols + col]), 3);
         }
     }
+    if (source.cols == region.width && source.rows == region.height)
+        return source;
+    cv::Mat result;
+    cv::resize(source, result, cv::Size(region.width, region.height), 0.0, 0.0, cv::INTER_AREA);
+    return result;
+}
 
-    return commands;
+// @brief Writes the Deep Zoom pyramid of the block image, the level 0 is a pixel and the top level is full size.
+// @note The tiles of a level are rendered on the workers, every tile only renders its own region.
+static void writeDeepZoom(const std::vector<int> &indices, int cols, int rows, const TextureAtlas &atlas,
+                          const std::string &path, int tileSize, int threadCount)
+{
+    int width = cols * atlas.tileSize();
+    int height = rows * atlas.tileSize();
+    int maxLevel = 0;
+    while ((1 << maxLevel) < std::max(width, height))
+        ++maxLevel;
+
+    std::ofstream descriptor(path + ".dzi");
+    descriptor << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" <<
+        "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"jpg\" Overlap=\"0\" TileSize=\"" <<
+        tileSize << "\">\n" << "    <Size Width=\"" << width << "\" Height=\"" << height << "\"/>\n" << "</Image>\n";
+
+    for (int level = 0; level <= maxLevel; ++level) {
+        int factor = 1 << (maxLevel - level);
+        int levelWidth = (width + factor - 1) / factor;
+        int levelHeight = (height + factor - 1) / factor;
+        int tileCols = (levelWidth + tileSize - 1) / tileSize;
+        int tileRows = (levelHeight + tileSize - 1) / tileSize;
+        std::string levelPath = path + "_files/" + std::to_string(level);
+        std::filesystem::create_directories(levelPath);
+        parallelFor(0, tileCols * tileRows, threadCount, [&](int begin, int end, int) {
+            for (int i = begin; i < end; ++i) {
+                int tileCol = i % tileCols;
+                int tileRow = i / tileCols;
+                cv::Rect region(tileCol * tileSize, tileRow * tileSize,
+                                std::min(tileSize, levelWidth - tileCol * tileSize),
+                                std::min(tileSize, levelHeight - tileRow * tileSize));
+                cv::imwrite(levelPath + "/" + std::to_string(tileCol) + "_" + std::to_string(tileRow) + ".jpg",
+                            renderScaledBlocks(indices, cols, rows, atlas, region, factor));
+            }
+        });
+    }
 }
 
-static Nbt::Tag getMcstructure(const BlockCube &blocks, Plane plane) {
-    using namespace Nbt;
+// @brief Writes the block image in the layout of the options, the path has no extension.
+static void writeBlockImage(const std::vector<int> &indices, int cols, int rows, const TextureAtlas &atlas,
+                            const std::string &path, const ConvertOptions &options)
+{
+    int width = cols * atlas.tileSize();
+    int height = rows * atlas.tileSize();
+    int tileSize = options.imageTileSize > 0 ? options.imageTileSize : 256;
+    switch (options.imageLayout) {
+        case ImageLayout::Strips:
+            for (int y = 0, i = 0; y < height; y += tileSize, ++i) {
+                cv::Rect region(0, y, width, std::min(tileSize, height - y));
+                cv::imwrite(path + "_" + std::to_string(i) + ".jpg",
+                            renderBlocks(indices, cols, atlas, region, options.threadCount));
+            }
+            break;
+        case ImageLayout::DeepZoom:
+            writeDeepZoom(indices, cols, rows, atlas, path, tileSize, options.threadCount);
+            break;
+        default:
+            cv::imwrite(path + ".jpg", renderBlocks(indices, cols, atlas, cv::Rect(0, 0, width, height),
+                                                    options.threadCount));
+            break;
+    }
+}
 
-    int xs = 0, ys = 0, zs = 0;
+// @brief Converts the position in the cube to the world position of the plane.
+static Posi toWorld(const Posi &pos, Plane plane) {
     switch (plane) {
-        case XY_Z:
-            xs = blocks.x;
-            ys = blocks.y;
-            zs = blocks.z;
-            break;
         case ZY_X:
-            xs = blocks.z;
-            ys = blocks.y;
-            zs = blocks.x;
-            break;
+            return Posi(pos.z, pos.y, pos.x);
         case XZ_Y:
-            xs = blocks.x;
-            ys = blocks.z;
-            zs = blocks.y;
-            break;
+            return Posi(pos.x, pos.z, pos.y);
         default:
+            return pos;
+    }
+}
+
+// The commands in a single buffer, every command is followed by a line break.
+struct CommandList
+{
+    std::string text;
+    // The end offset of every command in the text, the line break included.
+    std::vector<std::size_t> ends;
+
+    std::size_t size() const {
+        return ends.size();
+    }
+    void endLine() {
+        text += '\n';
+        ends.push_back(text.size());
+    }
+};
+
+// @brief Appends the fill command of the blocks range in the cube, the posTo is inclusive.
+// @param useNewExecute Uses the execute syntax since 1.19.50, or the old one.
+static void pushFill(CommandList &commands, const std::string &blockId,
+                     const Posi &posFrom, const Posi &posTo, Plane plane, bool useNewExecute)
+{
+    using namespace Command;
+    Posi from = toWorld(posFrom, plane);
+    Posi to = toWorld(posTo, plane);
+    auto fill = [&](std::string &buffer) {
+        appendFill(buffer, blockId, { from.x, from.y, from.z }, { to.x, to.y, to.z }, PosMode::Relative);
+    };
+    if (useNewExecute)
+        appendExecute(commands.text, Selector::Nearest, Selector::Own, fill);
+    else
+        appendOldExecute(commands.text, Selector::Nearest, { 0, 0, 0 }, fill, PosMode::Relative);
+    commands.endLine();
+}
+
+// The max blocks count of a fill command.
+constexpr int _MaxFillVolume = 32768;
+
+// @brief Gets the end of the run of the index from x along the row of (y, z), it is at most xMax.
+// @note The block of x must be the index.
+static int sameRunEnd(const BlockCube &blocks, int x, int xMax, int y, int z, std::uint16_t index) {
+    while (x < xMax && blocks.at(x + 1, y, z) == index)
+        ++x;
+    return x;
+}
+
+// @note A uniform chunk is passed in one step, its blocks are not read.
+static int sameRunEnd(const ChunkedBlockCube &blocks, int x, int xMax, int y, int z, std::uint16_t index) {
+    while (x < xMax) {
+        const ChunkedBlockCube::Chunk &chunk = blocks.chunk((x + 1) / blocks.chunkSize, y / blocks.chunkSize,
+                                                            z / blocks.chunkSize);
+        if (!chunk.isUniform()) {
+            if (blocks.at(x + 1, y, z) != index)
+                break;
+            ++x;
+            continue;
+        }
+        if (chunk.value != index)
             break;
+        x = std::min(((x + 1) / blocks.chunkSize + 1) * blocks.chunkSize - 1, xMax);
     }
+    return x;
+}
 
-    Tag formatVersion = gInt("format_version", 1);
-    Tag size = gList("size", Int);
-    size << gpInt(xs) << gpInt(ys) << gpInt(zs);
-    Tag swo = gList("structure_world_origin", Int);
-    swo << gpInt(0) << gpInt(0) << gpInt(0);
-    Tag data1 = gpList(Int);
-    Tag data2 = gpList(Int);
-    Tag blockPalette = gList("block_palette", Compound);
+// @brief Counts the runs of the same block along x in the range, that is the commands count without merging.
+template<typename Cube>
+static std::size_t countRuns(const Cube &blocks, const Posi &posFrom, const Posi &posTo) {
+    std::size_t count = 0;
+    for (int z = posFrom.z; z <= posTo.z; ++z) {
+        for (int y = posFrom.y; y <= posTo.y; ++y) {
+            ++count;
+            for (int x = posFrom.x + 1; x <= posTo.x; ++x) {
+                if (blocks.at(x, y, z) != blocks.at(x - 1, y, z))
+                    ++count;
+            }
+        }
+    }
+    return count;
+}
 
-    std::unordered_map<std::string, int> map;
-    int index = 0;
-    for (int x = 0; x < xs; ++x) {
-        for (int y = 0; y < ys; ++y) {
-            for (int z = 0; z < zs; ++z) {
-                std::string blockId;
-                switch (plane) {
-                    case XY_Z:
-                        blockId = blocks[x][y][z];
-                        break;
-                    case ZY_X:
-                        blockId = blocks[z][y][x];
-                        break;
-                    case XZ_Y:
-                        blockId = blocks[x][z][y];
-                        break;
-                    default:
+// @brief Splits the range in the cube into the boxes of the same block and appends their fill commands.
+// @note Greedy merging, every box starts at a block which is not covered yet, and grows along x, then y, then z as
+//       far as the blocks are the same and the volume is in the limit of a fill command. The boxes may overlap on
+//       the same blocks, so the commands are never more than the runs along x.
+// @param isNeeded Whether the block of (x, y, z) must be filled, the boxes only start at the needed blocks but may
+//                 cover the others which are the same.
+template<typename Cube, typename Needed>
+static void pushMergedFills(CommandList &commands, const Cube &blocks,
+                            const Posi &posFrom, const Posi &posTo, Plane plane, bool useNewExecute,
+                            Needed isNeeded)
+{
+    int sx = posTo.x - posFrom.x + 1;
+    int sy = posTo.y - posFrom.y + 1;
+    int sz = posTo.z - posFrom.z + 1;
+    std::vector<char> visited(static_cast<std::size_t>(sx) * sy * sz, 0);
+    auto isVisited = [&](int x, int y, int z) -> char & {
+        return visited[(static_cast<std::size_t>(z - posFrom.z) * sy + (y - posFrom.y)) * sx + (x - posFrom.x)];
+    };
+    // Whether the blocks from x to x1 in the row of (y, z) are all the index.
+    auto isSameRow = [&](int x, int x1, int y, int z, std::uint16_t index) {
+        return blocks.at(x, y, z) == index && sameRunEnd(blocks, x, x1, y, z, index) == x1;
+    };
+
+    for (int z = posFrom.z; z <= posTo.z; ++z) {
+        for (int y = posFrom.y; y <= posTo.y; ++y) {
+            for (int x = posFrom.x; x <= posTo.x; ++x) {
+                if (isVisited(x, y, z) || !isNeeded(x, y, z))
+                    continue;
+                std::uint16_t index = blocks.at(x, y, z);
+                // Grow along x.
+                int x1 = sameRunEnd(blocks, x, std::min(posTo.x, x + _MaxFillVolume - 1), y, z, index);
+                int width = x1 - x + 1;
+                // Grow along y by the whole rows.
+                int y1 = y;
+                while (y1 < posTo.y && width * (y1 - y + 2) <= _MaxFillVolume &&
+                       isSameRow(x, x1, y1 + 1, z, index))
+                    ++y1;
+                int area = width * (y1 - y + 1);
+                // Grow along z by the whole rectangles.
+                int z1 = z;
+                while (z1 < posTo.z && area * (z1 - z + 2) <= _MaxFillVolume) {
+                    bool same = true;
+                    for (int j = y; j <= y1 && same; ++j)
+                        same = isSameRow(x, x1, j, z1 + 1, index);
+                    if (!same)
                         break;
+                    ++z1;
                 }
-                data2 << gpInt(-1);
-                if (map.find(blockId) == map.end()) {
-                    map.insert({ blockId, index });
-                    data1.addMember(gpInt(index));
-                    Tag block = gCompound();
-                    block << gCompound("states") << gInt("version", 18103297) << gString("name", blockId);
-                    blockPalette << block;
-                    ++index;
-                    continue;
+                for (int k = z; k <= z1; ++k) {
+                    for (int j = y; j <= y1; ++j) {
+                        for (int i = x; i <= x1; ++i)
+                            isVisited(i, j, k) = 1;
+                    }
                 }
-                data1.addMember(gpInt(map[blockId]));
+                pushFill(commands, blocks.palette[index], Posi(x, y, z), Posi(x1, y1, z1), plane, useNewExecute);
             }
         }
     }
-    Tag s2 = gCompound("structure");
-    Tag s3 = gCompound("palette");
-    Tag s4 = gCompound("default");
-    s4 << gCompound("block_position_data") << blockPalette;
-    Tag s5 = gList("block_indices", List);
-    s5 << data1 << data2;
-    s3 << s4;;
-    s2 << s5 << gList("entities", End) << s3;
-    Tag root = gCompound();
-    root << formatVersion << size << s2 << swo;
-    return root;
 }
 
-static Nbt::Tag getAirStructure(int x, int y, int z, Plane plane) {
-    using namespace Nbt;
+// @brief Gets the fill commands of the blocks, the same blocks are merged into the boxes.
+// @param stats Receives the commands count before and after the merging if it is not null.
+static CommandList getCommands(const BlockCube &blocks, Plane plane,
+                               bool useNewExecute = true, ConvertStats *stats = nullptr)
+{
+    CommandList commands;
+    if (blocks.size == 0)
+        return commands;
+    Posi posFrom(0, 0, 0);
+    Posi posTo(blocks.x - 1, blocks.y - 1, blocks.z - 1);
+    pushMergedFills(commands, blocks, posFrom, posTo, plane, useNewExecute, [](int, int, int) { return true; });
+    if (stats != nullptr) {
+        stats->commandsBeforeMerge += countRuns(blocks, posFrom, posTo);
+        stats->commandsAfterMerge += commands.size();
+    }
+    return commands;
+}
 
-    int xs = 0, ys = 0, zs = 0;
-    switch (plane) {
-        case XY_Z:
-            xs = x;
-            ys = y;
-            zs = z;
-            break;
-        case ZY_X:
-            xs = z;
-            ys = y;
-            zs = x;
-            break;
-        case XZ_Y:
-            xs = x;
-            ys = z;
-            zs = y;
-            break;
-        default:
-            break;
+// @brief Gets the commands of the chunked blocks, they are the same as the commands of the flat blocks.
+// @note The boxes grow across the chunks, the rows in a uniform chunk are compared without reading its blocks.
+// @param stats Receives the commands count before and after the merging if it is not null.
+static CommandList getCommands(const ChunkedBlockCube &blocks, Plane plane,
+                               bool useNewExecute = true, ConvertStats *stats = nullptr)
+{
+    CommandList commands;
+    if (blocks.size == 0)
+        return commands;
+    Posi posFrom(0, 0, 0);
+    Posi posTo(blocks.x - 1, blocks.y - 1, blocks.z - 1);
+    pushMergedFills(commands, blocks, posFrom, posTo, plane, useNewExecute, [](int, int, int) { return true; });
+    if (stats != nullptr) {
+        stats->commandsBeforeMerge += countRuns(blocks, posFrom, posTo);
+        stats->commandsAfterMerge += commands.size();
     }
+    return commands;
+}
 
-    Tag formatVersion = gInt("format_version", 1);
-    Tag size = gList("size", Int);
-    size << gpInt(xs) << gpInt(ys) << gpInt(zs);
-    Tag swo = gList("structure_world_origin", Int);
-    swo << gpInt(0) << gpInt(0) << gpInt(0);
-    Tag data1 = gpList(Int);
-    Tag data2 = gpList(Int);
-    Tag blockPalette = gList("block_palette", Compound);
-    Tag block = gCompound();
-    block << gCompound("states") << gInt("version", 18103297) << gString("name", "minecraft:air");
-    blockPalette << block;
-
-    int all = x * y * z;
-    for (int i = 0; i < all; ++i) {
-        data1.addMember(gpInt(0));
-        data2 << gpInt(-1);
-    }
-    Tag s2 = gCompound("structure");
-    Tag s3 = gCompound("palette");
-    Tag s4 = gCompound("default");
-    s4 << gCompound("block_position_data") << blockPalette;
-    Tag s5 = gList("block_indices", List);
-    s5 << data1 << data2;
-    s3 << s4;;
-    s2 << s5 << gList("entities", End) << s3;
-    Tag root = gCompound();
-    root << formatVersion << size << s2 << swo;
-    return root;
-}
-
-static Bf::Dir makeFunctionPack(cv::Mat &img, BIModis &modis, const Mcpack::PackManifest &manifest,
-                                Plane plane = XY_Z, int maxWidth = 480, int maxHeight = 270,
-                                int maxCommandCount = 9000, bool useNewExecute = true)
-{
-    BlockCube blocks = getBlocks(img, modis, maxWidth, maxHeight);
-    std::vector<std::string> commands = getCommands(blocks, plane, useNewExecute);
-    Bf::Dir root = getMcpackFrame(manifest);
-
-    // Write command data.
-    int count = 0;
-    int index = 0;
-    for (auto &var : commands) {
-        if (++count > maxCommandCount) {
-            ++index;
-            count = 0;
+// @brief Gets the fill commands which turn the previous frame into the current frame.
+// @note The frames must have the same size and palette.
+static CommandList getDeltaCommands(const BlockCube &previous, const BlockCube &current, Plane plane,
+                                    bool useNewExecute = true) {
+    CommandList commands;
+    if (current.size == 0)
+        return commands;
+    pushMergedFills(commands, current, Posi(0, 0, 0), Posi(current.x - 1, current.y - 1, current.z - 1), plane,
+                    useNewExecute, [&](int x, int y, int z) { return previous.at(x, y, z) != current.at(x, y, z); });
+    return commands;
+}
+
+// @brief Gets the mcstructure file data of the blocks, it is streamed from the cube without the tag tree.
+// @note The chunked cube reads the uniform chunks without the allocation.
+template<typename Cube>
+static std::string getMcstructureData(const Cube &blocks, Plane plane) {
+    return getMcstructureData(blocks, plane, Posi(0, 0, 0), Posi(blocks.x - 1, blocks.y - 1, blocks.z - 1));
+}
+
+// @brief Gets the mcstructure file data of the blocks range in the cube, the posTo is inclusive.
+template<typename Cube>
+static std::string getMcstructureData(const Cube &blocks, Plane plane, const Posi &posFrom, const Posi &posTo) {
+    Posi size = toWorld(Posi(posTo.x - posFrom.x + 1, posTo.y - posFrom.y + 1, posTo.z - posFrom.z + 1), plane);
+    std::string data;
+    Mcstructure::write(data, size.x, size.y, size.z, blocks.palette, [&](int x, int y, int z) {
+        Posi pos = toWorld(Posi(x, y, z), plane);
+        return blocks.at(posFrom.x + pos.x, posFrom.y + pos.y, posFrom.z + pos.z);
+    });
+    return data;
+}
+
+// @brief Gets the relative position of the command, such as ~~~ or ~1 ~0 ~2.
+static std::string posToStr(const Posi &pos) {
+    if (pos.x == 0 && pos.y == 0 && pos.z == 0)
+        return "~~~";
+    return "~" + std::to_string(pos.x) + " ~" + std::to_string(pos.y) + " ~" + std::to_string(pos.z);
+}
+
+// A structure of the video frame, it is loaded at the offset from the frame origin.
+struct FramePiece
+{
+    std::string name;
+    Posi offset;
+    std::string data;
+    // Whether it is the structure of an earlier frame, which is already written.
+    bool isReused = false;
+};
+
+// @brief Gets the bounding boxes of the changed blocks in every tile along x and y, the posTo is inclusive.
+// @note The frames must have the same size and palette.
+static std::vector<std::pair<Posi, Posi>> getDirtyBoxes(const BlockCube &previous, const BlockCube &current,
+                                                       int tileSize)
+{
+    std::vector<std::pair<Posi, Posi>> boxes;
+    for (int tx = 0; tx < current.x; tx += tileSize) {
+        for (int ty = 0; ty < current.y; ty += tileSize) {
+            Posi posFrom(INT_MAX, INT_MAX, INT_MAX);
+            Posi posTo(-1, -1, -1);
+            for (int x = tx; x < std::min(tx + tileSize, current.x); ++x) {
+                for (int y = ty; y < std::min(ty + tileSize, current.y); ++y) {
+                    for (int z = 0; z < current.z; ++z) {
+                        if (previous.at(x, y, z) == current.at(x, y, z))
+                            continue;
+                        posFrom = Posi(std::min(posFrom.x, x), std::min(posFrom.y, y), std::min(posFrom.z, z));
+                        posTo = Posi(std::max(posTo.x, x), std::max(posTo.y, y), std::max(posTo.z, z));
+                    }
+                }
+            }
+            if (posTo.x >= 0)
+                boxes.emplace_back(posFrom, posTo);
         }
-        root["functions"][manifest.prefix]["data"]("d" + std::to_string(index) + ".mcfunction") <<
-            var << "\n";
     }
+    return boxes;
+}
+
+// @brief Gets the structures of the frame, a delta frame only has the changed boxes of the previous frame.
+// @param previous The previous frame, null for a keyframe.
+// @note It falls back to the full frame when the boxes cover more than half of it.
+static std::vector<FramePiece> getFramePieces(const BlockCube &blocks, const BlockCube *previous, int index,
+                                              int tileSize, Plane plane, ConvertStats *stats)
+{
+    std::string name = "d" + std::to_string(index);
+    std::vector<FramePiece> pieces;
+    if (previous != nullptr && previous->x == blocks.x && previous->y == blocks.y && previous->z == blocks.z &&
+        previous->palette == blocks.palette)
+    {
+        std::vector<std::pair<Posi, Posi>> boxes = getDirtyBoxes(*previous, blocks, tileSize > 0 ? tileSize : 16);
+        std::size_t volume = 0;
+        for (auto &box : boxes) {
+            volume += static_cast<std::size_t>(box.second.x - box.first.x + 1) *
+                (box.second.y - box.first.y + 1) * (box.second.z - box.first.z + 1);
+        }
+        if (volume * 2 <= blocks.size) {
+            for (std::size_t i = 0; i < boxes.size(); ++i) {
+                pieces.push_back({ name + "_" + std::to_string(i), toWorld(boxes[i].first, plane),
+                                   getMcstructureData(blocks, plane, boxes[i].first, boxes[i].second) });
+            }
+            // The frame without the change only loads the previous structures again.
+            if (stats != nullptr && boxes.empty())
+                ++stats->dedupFrameCount;
+            else if (stats != nullptr)
+                ++stats->deltaFrameCount;
+            return pieces;
+        }
+    }
+    pieces.push_back({ name, Posi(0, 0, 0), getMcstructureData(blocks, plane) });
+    return pieces;
+}
+
+static std::string getAirStructureData(int x, int y, int z, Plane plane) {
+    Posi size = toWorld(Posi(x, y, z), plane);
+    std::string data;
+    Mcstructure::write(data, size.x, size.y, size.z, std::vector<std::string>(1, "minecraft:air"),
+                       [](int, int, int) { return std::uint16_t(0); });
+    return data;
+}
+
+// @return Nothing if the image has no blocks.
+static std::optional<Mcpack::PackDir> makeFunctionPack(cv::Mat &img, const Quantizer::Matcher &matcher,
+                                const Mcpack::PackManifest &manifest, Plane plane = XY_Z, int maxWidth = 480,
+                                int maxHeight = 270, int maxCommandCount = 9000, bool useNewExecute = true,
+                                const ConvertOptions &options = ConvertOptions())
+{
+    CommandList commands;
+    Posi area;
+    if (options.chunkSize > 0) {
+        ChunkedBlockCube blocks = getBlocks<ChunkedBlockCube>(img, matcher, maxWidth, maxHeight, nullptr,
+                                                              options.threadCount, options.chunkSize);
+        commands = getCommands(blocks, plane, useNewExecute, options.stats);
+        area = toWorld(Posi(blocks.x, blocks.y, blocks.z), plane);
+    } else {
+        BlockCube blocks = getBlocks(img, matcher, maxWidth, maxHeight, nullptr, options.threadCount);
+        commands = getCommands(blocks, plane, useNewExecute, options.stats);
+        area = toWorld(Posi(blocks.x, blocks.y, blocks.z), plane);
+    }
+    if (commands.size() == 0) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "The image has no blocks." << std::endl;
+        return std::nullopt;
+    }
+    Mcpack::PackDir pack(manifest);
+
+    // Write command data, every function takes at most maxCommandCount commands.
+    std::size_t groupSize = static_cast<std::size_t>(std::max(maxCommandCount, 1));
+    int index = 0;
+    for (std::size_t begin = 0; begin < commands.size(); begin += groupSize, ++index) {
+        std::size_t end = std::min(begin + groupSize, commands.size());
+        std::size_t textBegin = begin == 0 ? 0 : commands.ends[begin - 1];
+        pack.file("functions/" + manifest.prefix + "/data/d" + std::to_string(index) + ".mcfunction") <<
+            commands.text.substr(textBegin, commands.ends[end - 1] - textBegin);
+    }
+    // The control runs the functions d0 to d(index).
+    --index;
 
     // Write AUX control data.
-    Bf::File &control = root["functions"][manifest.prefix]["aux"]("control.mcfunction");
+    Bf::File &control = pack.file("functions/" + manifest.prefix + "/aux/control.mcfunction");
     std::string scoreboardObj = manifest.prefix + "_Control";
     std::string scoreboardPly = manifest.prefix + "_Dummy";
     for (int i = 0; i <= index; ++i) {
@@ -410,87 +847,349 @@ static Bf::Dir makeFunctionPack(cv::Mat &img, BIModis &modis, const Mcpack::Pack
     control << "execute if score " << scoreboardPly << " " << scoreboardObj << " matches " <<
         std::to_string(index + 1) << " run " << "scoreboard objectives remove " << scoreboardObj;
 
-    // Get area size.
-    int xs = 0, ys = 0, zs = 0;
-    switch (plane) {
-        case XY_Z:
-            xs = blocks.x;
-            ys = blocks.y;
-            zs = blocks.z;
-            break;
-        case ZY_X:
-            xs = blocks.z;
-            ys = blocks.y;
-            zs = blocks.x;
-            break;
-        case XZ_Y:
-            xs = blocks.x;
-            ys = blocks.z;
-            zs = blocks.y;
-            break;
-        default:
-            break;
+    // Write start control.
+    Bf::File &start = pack.file("functions/" + manifest.prefix + "/start.mcfunction");
+    start << "scoreboard objectives add " << scoreboardObj << " dummy\n";
+    start << "tickingarea add ~~~ ~" + std::to_string(area.x - 1) + " ~" + std::to_string(area.y - 1) + " ~" +
+        std::to_string(area.z - 1) + " " + manifest.prefix + "_Tickarea\n";
+    start << "execute unless score " << scoreboardPly << " " << scoreboardObj <<
+        " matches 0.. run scoreboard players set " << scoreboardPly + " " << scoreboardObj << " 0";
+
+    // Write tick json.
+    rapidjson::Document dom;
+    dom.Parse(pack.file("functions/tick.json").data().c_str());
+    rapidjson::Value controlPath((manifest.prefix + "/aux/control").c_str(), dom.GetAllocator());
+    dom["values"].GetArray().PushBack(controlPath, dom.GetAllocator());
+    pack.file("functions/tick.json") = domToStr(dom);
+
+    // Save all.
+    return pack;
+}
+
+// @brief Writes the commands into the functions of the path, every function takes at most maxCommandCount
+//        commands, the name is followed by the function index if there are more than one.
+// @return The function paths without the extension.
+static std::vector<std::string> writeFunctions(Mcpack::PackDir &pack, const std::string &dirPath,
+                                               const std::string &name, const CommandList &commands,
+                                               int maxCommandCount)
+{
+    std::vector<std::string> paths;
+    std::size_t groupSize = static_cast<std::size_t>(std::max(maxCommandCount, 1));
+    for (std::size_t begin = 0; begin < commands.size(); begin += groupSize) {
+        std::size_t end = std::min(begin + groupSize, commands.size());
+        std::size_t textBegin = begin == 0 ? 0 : commands.ends[begin - 1];
+        std::string functionName = commands.size() > groupSize ?
+            name + "_" + std::to_string(begin / groupSize) : name;
+        pack.file("functions/" + dirPath + "/" + functionName + ".mcfunction") <<
+            commands.text.substr(textBegin, commands.ends[end - 1] - textBegin);
+        paths.push_back(dirPath + "/" + functionName);
+    }
+    return paths;
+}
+
+// @brief Makes the function pack which plays the video, a frame per tick.
+// @note The first frame is filled in whole, the other frames only fill the blocks which differ from the previous
+//       frame, so the commands of a tick depend on the amount of the change.
+// @return Nothing if no frame is decoded.
+static std::optional<Mcpack::PackDir> makeFunctionPack(cv::VideoCapture &video, const Quantizer::Matcher &matcher,
+                                const Mcpack::PackManifest &manifest, Plane plane = XY_Z, int maxWidth = 480,
+                                int maxHeight = 270, int maxFrameCount = 200, int maxCommandCount = 9000,
+                                bool useNewExecute = true, const ConvertOptions &options = ConvertOptions())
+{
+    FrameSampler sampler(video, maxFrameCount, options);
+    int totalFrame = sampler.frameCount();
+    Mcpack::PackDir pack(manifest);
+    std::string dataPath = manifest.prefix + "/data";
+
+    // Write command data, the functions of every frame.
+    std::vector<std::vector<std::string>> frames;
+    BlockCube previous;
+    Posi area;
+    cv::Mat frame;
+    TemporalCache cache(options.temporalTolerance);
+    for (int i = 0; i < totalFrame && sampler.read(frame); ++i) {
+        BlockCube blocks = getBlocks(frame, matcher, maxWidth, maxHeight, nullptr, options.threadCount, 0,
+                                     cache.isEnabled() ? &cache : nullptr);
+        CommandList commands;
+        if (i == 0 || previous.x != blocks.x || previous.y != blocks.y || previous.palette != blocks.palette) {
+            commands = getCommands(blocks, plane, useNewExecute, options.stats);
+            area = toWorld(Posi(blocks.x, blocks.y, blocks.z), plane);
+        } else {
+            commands = getDeltaCommands(previous, blocks, plane, useNewExecute);
+        }
+        frames.push_back(writeFunctions(pack, dataPath, "f" + std::to_string(i), commands, maxCommandCount));
+        previous = std::move(blocks);
+    }
+    totalFrame = static_cast<int>(frames.size());
+    cache.addTo(options.stats);
+    if (totalFrame == 0 || area.x <= 0 || area.y <= 0 || area.z <= 0) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "The video has no frame." << std::endl;
+        return std::nullopt;
     }
 
+    // Write AUX control data.
+    Bf::File &control = pack.file("functions/" + manifest.prefix + "/aux/control.mcfunction");
+    std::string scoreboardObj = manifest.prefix + "_Control";
+    std::string scoreboardPly = manifest.prefix + "_Dummy";
+    for (int i = 0; i < totalFrame; ++i) {
+        for (auto &path : frames[i]) {
+            control << "execute if score " << scoreboardPly << " " << scoreboardObj <<
+                " matches " << std::to_string(i) << " run function " << path << "\n";
+        }
+    }
+    control << "execute if score " << scoreboardPly << " " << scoreboardObj << " matches 0.. run " <<
+        "scoreboard players add " << scoreboardPly << " " << scoreboardObj << " 1\n";
+    control << "execute if score " << scoreboardPly << " " << scoreboardObj << " matches " <<
+        std::to_string(totalFrame) << " run " << "tickingarea remove " << manifest.prefix + "_Tickarea\n";
+    control << "execute if score " << scoreboardPly << " " << scoreboardObj << " matches " <<
+        std::to_string(totalFrame) << " run " << "scoreboard objectives remove " << scoreboardObj;
+
     // Write start control.
-    Bf::File &start = root["functions"][manifest.prefix]("start.mcfunction");
+    Bf::File &start = pack.file("functions/" + manifest.prefix + "/start.mcfunction");
     start << "scoreboard objectives add " << scoreboardObj << " dummy\n";
-    start << "tickingarea add ~~~ ~" + std::to_string(xs - 1) + " ~" + std::to_string(ys - 1) + " ~" +
-        std::to_string(zs - 1) + " " + manifest.prefix + "_Tickarea\n";
+    start << "tickingarea add ~~~ ~" + std::to_string(area.x - 1) + " ~" + std::to_string(area.y - 1) + " ~" +
+        std::to_string(area.z - 1) + " " + manifest.prefix + "_Tickarea\n";
     start << "execute unless score " << scoreboardPly << " " << scoreboardObj <<
         " matches 0.. run scoreboard players set " << scoreboardPly + " " << scoreboardObj << " 0";
 
     // Write tick json.
     rapidjson::Document dom;
-    dom.Parse(root["functions"]("tick.json").data().c_str());
+    dom.Parse(pack.file("functions/tick.json").data().c_str());
     rapidjson::Value controlPath((manifest.prefix + "/aux/control").c_str(), dom.GetAllocator());
     dom["values"].GetArray().PushBack(controlPath, dom.GetAllocator());
-    root["functions"]("tick.json") = domToStr(dom);
+    pack.file("functions/tick.json") = domToStr(dom);
 
-    // Save all.
-    return root;
+    return pack;
+}
+
+// @brief Gets the fingerprint of the frame blocks, FNV-1a of the size and the palette indices.
+static std::uint64_t frameHash(const BlockCube &blocks) {
+    std::uint64_t hash = 14695981039346656037ull;
+    auto feed = [&hash](std::uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    feed(static_cast<std::uint64_t>(blocks.x));
+    feed(static_cast<std::uint64_t>(blocks.y));
+    feed(static_cast<std::uint64_t>(blocks.z));
+    for (std::uint16_t index : blocks.indices)
+        feed(index);
+    return hash;
+}
+
+// @brief Gets whether the frames show the same blocks.
+static bool isSameFrame(const BlockCube &a, const BlockCube &b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.palette == b.palette && a.indices == b.indices;
+}
+
+// @brief Gets whether the frames differ in at most the tolerance ratio of the blocks.
+static bool isSimilarFrame(const BlockCube &a, const BlockCube &b, double tolerance) {
+    if (a.x != b.x || a.y != b.y || a.z != b.z || a.palette != b.palette)
+        return false;
+    std::size_t limit = static_cast<std::size_t>(tolerance * a.size);
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < a.indices.size(); ++i) {
+        if (a.indices[i] != b.indices[i] && ++count > limit)
+            return false;
+    }
+    return true;
 }
 
-static Bf::Dir makeStructurePack(cv::Mat &img, BIModis &modis, const Mcpack::PackManifest &manifest,
-                                 Plane plane = XY_Z, int maxWidth = 480, int maxHeight = 270)
+// @brief Turns the video frames into the structures in order, with the delta frames and the deduplication.
+class FrameEncoder
 {
-    BlockCube blocks = getBlocks(img, modis, maxWidth, maxHeight);
-    Nbt::Tag tag = getMcstructure(blocks, plane);
-    Bf::Dir root = getMcpackFrame(manifest);
+public:
+    FrameEncoder(Plane plane, const ConvertOptions &options) : plane_(plane), options_(options) {}
+
+    std::vector<FramePiece> encode(const BlockCube &blocks) {
+        int index = index_++;
+        if (options_.dedupFrames) {
+            std::vector<FramePiece> pieces = findDuplicate(blocks);
+            if (!pieces.empty()) {
+                if (options_.stats != nullptr)
+                    ++options_.stats->dedupFrameCount;
+                return pieces;
+            }
+        }
+        bool isKeyframe = options_.keyframeInterval <= 0 || index % options_.keyframeInterval == 0;
+        std::vector<FramePiece> pieces = getFramePieces(blocks, isKeyframe || !hasPrevious_ ? nullptr : &previous_,
+                                                        index, options_.deltaTileSize, plane_, options_.stats);
+        if (options_.dedupFrames && pieces.size() == 1 && pieces[0].name == "d" + std::to_string(index))
+            fullFrames_.emplace(frameHash(blocks), FullFrame{ pieces[0].name, blocks });
+        if (options_.dedupFrames || options_.keyframeInterval > 0) {
+            previous_ = blocks;
+            hasPrevious_ = true;
+            previousPieces_ = pieces;
+            for (auto &piece : previousPieces_) {
+                piece.data.clear();
+                piece.isReused = true;
+            }
+        }
+        return pieces;
+    }
+
+private:
+    // @brief Gets the structures of an earlier frame which shows the same blocks, empty if there is no such frame.
+    std::vector<FramePiece> findDuplicate(const BlockCube &blocks) {
+        // Loading the previous structures again keeps the previous frame, which is in the tolerance.
+        if (hasPrevious_ && isSimilarFrame(previous_, blocks, options_.dedupTolerance))
+            return previousPieces_;
+        // The fingerprints may collide, so the blocks of the frames are compared too.
+        auto range = fullFrames_.equal_range(frameHash(blocks));
+        auto it = std::find_if(range.first, range.second, [&blocks](const auto &frame) {
+            return isSameFrame(frame.second.blocks, blocks);
+        });
+        if (it == range.second)
+            return std::vector<FramePiece>();
+        FramePiece piece;
+        piece.name = it->second.name;
+        piece.isReused = true;
+        previous_ = blocks;
+        previousPieces_ = std::vector<FramePiece>(1, piece);
+        return previousPieces_;
+    }
+
+    Plane plane_;
+    const ConvertOptions &options_;
+    int index_ = 0;
+    // The blocks which are shown after the previous frame is loaded, and the structures of the previous frame.
+    BlockCube previous_;
+    bool hasPrevious_ = false;
+    std::vector<FramePiece> previousPieces_;
+    // The full structure of a frame and the blocks it shows.
+    struct FullFrame
+    {
+        std::string name;
+        BlockCube blocks;
+    };
+    // The full structures of the frames by the frame fingerprint.
+    std::unordered_multimap<std::uint64_t, FullFrame> fullFrames_;
+};
 
-    std::stringstream ss;
-    tag.write(ss);
-    root["structures"][manifest.prefix]("data.mcstructure") = ss.str();
+static Mcpack::PackDir makeStructurePack(cv::Mat &img, const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest,
+                                 Plane plane = XY_Z, int maxWidth = 480, int maxHeight = 270,
+                                 const ConvertOptions &options = ConvertOptions())
+{
+    Mcpack::PackDir pack(manifest);
+    if (options.chunkSize > 0) {
+        ChunkedBlockCube blocks = getBlocks<ChunkedBlockCube>(img, matcher, maxWidth, maxHeight, nullptr,
+                                                              options.threadCount, options.chunkSize);
+        pack.file("structures/" + manifest.prefix + "/data.mcstructure") = getMcstructureData(blocks, plane);
+    } else {
+        BlockCube blocks = getBlocks(img, matcher, maxWidth, maxHeight, nullptr, options.threadCount);
+        pack.file("structures/" + manifest.prefix + "/data.mcstructure") = getMcstructureData(blocks, plane);
+    }
 
-    return root;
+    return pack;
 }
 
-static Bf::Dir makeStructurePack(cv::VideoCapture &video, BIModis &modis, const Mcpack::PackManifest &manifest,
+static Mcpack::PackDir makeStructurePack(cv::VideoCapture &video, const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest,
                                  Plane plane = XY_Z, int maxWidth = 480, int maxHeight = 270,
-                                 int maxFrameCount = 200, bool detachFrame = true)
+                                 int maxFrameCount = 200, bool detachFrame = true,
+                                 const ConvertOptions &options = ConvertOptions())
 {
     if (detachFrame) {
-        int totalFrame = static_cast<int>(video.get(cv::CAP_PROP_FRAME_COUNT));
-        totalFrame = totalFrame < maxFrameCount ? totalFrame : maxFrameCount;
-        Bf::Dir root = getMcpackFrame(manifest);
-        cv::Mat frame;
-        for (int i = 0; i < totalFrame; ++i) {
-            video.read(frame);
-            BlockCube blocks = getBlocks(frame, modis, maxWidth, maxHeight);
-            Nbt::Tag tag = getMcstructure(blocks, plane);
-            std::stringstream ss;
-            tag.write(ss);
-            root["structures"][manifest.prefix]("d" + std::to_string(i) + ".mcstructure") = ss.str();
+        FrameSampler sampler(video, maxFrameCount, options);
+        int totalFrame = sampler.frameCount();
+        Mcpack::PackDir pack(manifest);
+
+        // The stages run on their own threads and pass the frames through the queues:
+        // decode -> scale, quantize (and encode) on the frame workers -> reorder -> encode -> write (this thread).
+        // The frames between the decoding and the reordering are capped by the window.
+        struct FrameJob
+        {
+            int index = 0;
+            cv::Mat frame;
+            BlockCube blocks;
+            std::vector<FramePiece> pieces;
+        };
+        // The temporal cache reuses the blocks of the previous frame, so the frames are mapped in order on one
+        // worker when it is enabled, and the pixels of a frame are mapped on the threads.
+        TemporalCache cache(options.temporalTolerance);
+        int frameWorkers = cache.isEnabled() ? 1 : workerCount(options.frameWorkers);
+        // The delta frames and the deduplication depend on the previous frames, so they are encoded in order.
+        bool isEncodedInOrder = options.keyframeInterval > 0 || options.dedupFrames;
+        BoundedQueue<FrameJob> decoded(_PipelineQueueSize);
+        OrderedQueue<FrameJob> quantized(options.frameWindow > 0 ? options.frameWindow : frameWorkers * 2);
+        BoundedQueue<FrameJob> encoded(_PipelineQueueSize);
+        std::thread decoder([&] {
+            for (int i = 0; i < totalFrame; ++i) {
+                FrameJob job;
+                job.index = i;
+                if (!sampler.read(job.frame) || !quantized.reserve(i) || !decoded.push(std::move(job)))
+                    break;
+            }
+            decoded.close();
+        });
+        std::vector<std::thread> quantizers;
+        for (int worker = 0; worker < frameWorkers; ++worker) {
+            quantizers.emplace_back([&] {
+                FrameJob job;
+                while (decoded.pop(job)) {
+                    job.blocks = getBlocks(job.frame, matcher, maxWidth, maxHeight, nullptr,
+                                           frameWorkers > 1 ? 1 : options.threadCount, 0,
+                                           cache.isEnabled() ? &cache : nullptr);
+                    job.frame.release();
+                    if (!isEncodedInOrder) {
+                        job.pieces = getFramePieces(job.blocks, nullptr, job.index, options.deltaTileSize, plane,
+                                                    nullptr);
+                    }
+                    quantized.push(job.index, std::move(job));
+                }
+            });
+        }
+        std::thread encoder([&] {
+            FrameJob job;
+            FrameEncoder frameEncoder(plane, options);
+            while (quantized.pop(job)) {
+                if (isEncodedInOrder)
+                    job.pieces = frameEncoder.encode(job.blocks);
+                if (!encoded.push(std::move(job)))
+                    break;
+            }
+            encoded.close();
+        });
+        std::thread closer([&] {
+            for (auto &quantizer : quantizers)
+                quantizer.join();
+            quantized.close();
+        });
+        FrameJob job;
+        // The structures of every frame, without the data.
+        std::vector<std::vector<FramePiece>> frames;
+        int width = 0;
+        int height = 0;
+        while (encoded.pop(job)) {
+            width = job.blocks.x;
+            height = job.blocks.y;
+            for (auto &piece : job.pieces) {
+                if (piece.isReused)
+                    continue;
+                pack.file("structures/" + manifest.prefix + "/" + piece.name + ".mcstructure") =
+                    std::move(piece.data);
+                piece.data.clear();
+            }
+            frames.push_back(std::move(job.pieces));
         }
+        int frameCount = static_cast<int>(frames.size());
+        decoder.join();
+        closer.join();
+        encoder.join();
+        cache.addTo(options.stats);
+        // Only the decoded frames are played.
+        totalFrame = frameCount;
 
         // Write AUX control data.
-        Bf::File &control = root["functions"][manifest.prefix]["aux"]("control.mcfunction");
+        Bf::File &control = pack.file("functions/" + manifest.prefix + "/aux/control.mcfunction");
         std::string scoreboardObj = manifest.prefix + "_Control";
         std::string scoreboardPly = manifest.prefix + "_Dummy";
         for (int i = 0; i < totalFrame; ++i) {
-            control << "execute as @e[name=" << "__" + manifest.prefix << ",c=1] at @s if score " << scoreboardPly <<
-                " " << scoreboardObj << " matches " << std::to_string(i) << " run structure load " <<
-                manifest.prefix << ":d" << std::to_string(i) << " ~~~\n";
+            for (auto &piece : frames[i]) {
+                control << "execute as @e[name=" << "__" + manifest.prefix << ",c=1] at @s if score " <<
+                    scoreboardPly << " " << scoreboardObj << " matches " << std::to_string(i) <<
+                    " run structure load " << manifest.prefix << ":" << piece.name << " " << posToStr(piece.offset) <<
+                    "\n";
+            }
         }
         control << "execute if score " << scoreboardPly << " " << scoreboardObj << " matches 0.. run " <<
             "scoreboard players add " << scoreboardPly << " " << scoreboardObj << " 1\n";
@@ -502,8 +1201,6 @@ static Bf::Dir makeStructurePack(cv::VideoCapture &video, BIModis &modis, const
             std::to_string(totalFrame) << " run " << "scoreboard objectives remove " << scoreboardObj;
 
         // Get area size.
-        int width = frame.cols;
-        int height = frame.rows;
         int xs = 0, ys = 0, zs = 0;
         switch (plane) {
             case XY_Z:
@@ -526,12 +1223,12 @@ static Bf::Dir makeStructurePack(cv::VideoCapture &video, BIModis &modis, const
         }
 
         // Write setO control.
-        Bf::File &setO = root["functions"][manifest.prefix]("setO.mcfunction");
+        Bf::File &setO = pack.file("functions/" + manifest.prefix + "/setO.mcfunction");
         setO << "execute as @p at @s run summon minecraft:armor_stand __" + manifest.prefix << "\n";
         setO << "execute as @e[type=minecraft:armor_stand,name=__" + manifest.prefix + "] at @s run effect @s invisibility 999999 0 true";
 
         // Write play control.
-        Bf::File &play = root["functions"][manifest.prefix]("play.mcfunction");
+        Bf::File &play = pack.file("functions/" + manifest.prefix + "/play.mcfunction");
         play << "scoreboard objectives add " << scoreboardObj << " dummy\n";
         play << "execute as @e[name=" << "__" + manifest.prefix << ",c=1] at @s run tickingarea add ~~~ ~" +
             std::to_string(xs - 1) + " ~" + std::to_string(ys - 1) + " ~" +
@@ -541,27 +1238,34 @@ static Bf::Dir makeStructurePack(cv::VideoCapture &video, BIModis &modis, const
 
         // Write tick json.
         rapidjson::Document dom;
-        dom.Parse(root["functions"]("tick.json").data().c_str());
+        dom.Parse(pack.file("functions/tick.json").data().c_str());
         rapidjson::Value controlPath((manifest.prefix + "/aux/control").c_str(), dom.GetAllocator());
         dom["values"].GetArray().PushBack(controlPath, dom.GetAllocator());
-        root["functions"]("tick.json") = domToStr(dom);
+        pack.file("functions/tick.json") = domToStr(dom);
 
-        return root;
+        return pack;
     }
 
-    BlockCube blocks = getBlocks(video, modis, maxFrameCount, maxWidth, maxHeight);
-    Nbt::Tag tag = getMcstructure(blocks, plane);
-    Bf::Dir root = getMcpackFrame(manifest);
-    std::stringstream ss;
-    tag.write(ss);
-    root["structures"][manifest.prefix]("data.mcstructure") = ss.str();
+    Mcpack::PackDir pack(manifest);
+    FrameSampler sampler(video, maxFrameCount, options);
+    TemporalCache cache(options.temporalTolerance);
+    TemporalCache *cachePtr = cache.isEnabled() ? &cache : nullptr;
+    if (options.chunkSize > 0) {
+        ChunkedBlockCube blocks = getBlocks<ChunkedBlockCube>(sampler, matcher, maxWidth, maxHeight, nullptr,
+                                                              options.threadCount, options.chunkSize, cachePtr);
+        pack.file("structures/" + manifest.prefix + "/data.mcstructure") = getMcstructureData(blocks, plane);
+    } else {
+        BlockCube blocks = getBlocks(sampler, matcher, maxWidth, maxHeight, nullptr, options.threadCount, 0,
+                                     cachePtr);
+        pack.file("structures/" + manifest.prefix + "/data.mcstructure") = getMcstructureData(blocks, plane);
+    }
+    cache.addTo(options.stats);
 
-    return root;
+    return pack;
 }
 
-BIModis filterBIRaws(const BIRaws &raws, Plane plane, int attribute, Version version) {
-    int face = 0;
-    int alignment = 0;
+// @brief Gets the face and the alignment of the blocks which are placed along the plane.
+static void getPlaneFilter(Plane plane, int &face, int &alignment) {
     if (plane == XY_Z || plane == ZY_X) {
         face = BlockFlag::Side;
         alignment = BlockFlag::Vertical;
@@ -569,58 +1273,139 @@ BIModis filterBIRaws(const BIRaws &raws, Plane plane, int attribute, Version ver
         face = BlockFlag::Top;
         alignment = BlockFlag::Horizontal;
     }
+}
+
+BIModis filterBIRaws(const BIRaws &raws, Plane plane, int attribute, Version version) {
+    int face = 0;
+    int alignment = 0;
+    getPlaneFilter(plane, face, alignment);
     return rawsToModis(raws, face, alignment, attribute, version);
 }
 
+BIModis filterBIRaws(const BlockDb &db, Plane plane, int attribute, Version version) {
+    int face = 0;
+    int alignment = 0;
+    getPlaneFilter(plane, face, alignment);
+    return db.modis(face, alignment, attribute, version);
+}
+
+std::shared_ptr<const PaletteView> getPaletteView(PaletteRegistry &registry, Plane plane, int attribute,
+                                                  Version version, int type) {
+    int face = 0;
+    int alignment = 0;
+    getPlaneFilter(plane, face, alignment);
+    return registry.get(face, alignment, attribute, version, type);
+}
+
+void makeBlockImage(const std::string &imgPath, const std::string &outputPath,
+                    const Quantizer::Matcher &matcher, const TextureAtlas &atlas, int maxWidth, int maxHeight,
+                    std::unordered_map<std::string, int> *blocksInfo, const ConvertOptions &options)
+{
+    if (atlas.empty() || atlas.paletteSize() != static_cast<int>(matcher.modis().size())) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " <<
+            "The atlas is not loaded from the palette." << std::endl;
+        return;
+    }
+    cv::Mat img = cv::imread(imgPath);
+    std::vector<int> indices;
+    if (!getBlockIndices(img, matcher, maxWidth, maxHeight, blocksInfo, options.threadCount, indices))
+        return;
+    writeBlockImage(indices, img.cols, img.rows, atlas,
+                    outputPath + "/" + Bf::getFileName(imgPath) + "_BlockImage", options);
+}
+
+void makeBlockImage(const std::string &imgPath, const std::string &outputPath,
+                    const Quantizer::Matcher &matcher, const std::string &texturePath, int maxWidth, int maxHeight,
+                    std::unordered_map<std::string, int> *blocksInfo, const ConvertOptions &options)
+{
+    makeBlockImage(imgPath, outputPath, matcher, TextureAtlas::load(matcher.modis(), texturePath, 0,
+                                                                    options.threadCount),
+                   maxWidth, maxHeight, blocksInfo, options);
+}
+
 void makeBlockImage(const std::string &imgPath, const std::string &outputPath,
                     BIModis &modis, const std::string &texturePath, int maxWidth, int maxHeight,
-                    std::unordered_map<std::string, int> *blocksInfo)
+                    std::unordered_map<std::string, int> *blocksInfo, const ConvertOptions &options)
+{
+    makeBlockImage(imgPath, outputPath, Quantizer::Matcher(modis), texturePath, maxWidth, maxHeight, blocksInfo,
+                   options);
+}
+
+void makeImageFunctionPack(const std::string &imgPath, const std::string &outputPath,
+                           const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest, Plane plane,
+                           int maxWidth, int maxHeight, int maxCommandCount, bool useNewExecute,
+                           bool isCompress, const ConvertOptions &options)
 {
     cv::Mat img = cv::imread(imgPath);
-    cv::Mat result = getBlockImage(img, modis, texturePath, maxWidth, maxHeight, blocksInfo);
-    cv::imwrite(outputPath + "/" + Bf::getFileName(imgPath) + "_BlockImage.jpg", result);
+    std::optional<Mcpack::PackDir> pack = makeFunctionPack(img, matcher, manifest, plane, maxWidth, maxHeight,
+                                                           maxCommandCount, useNewExecute, options);
+    if (pack)
+        pack->write(outputPath, isCompress, options.zipLevels, options.threadCount);
 }
 
 void makeImageFunctionPack(const std::string &imgPath, const std::string &outputPath,
                            BIModis &modis, const Mcpack::PackManifest &manifest, Plane plane,
                            int maxWidth, int maxHeight, int maxCommandCount, bool useNewExecute,
-                           bool isCompress)
+                           bool isCompress, const ConvertOptions &options)
+{
+    makeImageFunctionPack(imgPath, outputPath, Quantizer::Matcher(modis), manifest, plane, maxWidth, maxHeight,
+                          maxCommandCount, useNewExecute, isCompress, options);
+}
+
+void makeVideoFunctionPack(const std::string &videoPath, const std::string &outputPath,
+                           const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest, Plane plane,
+                           int maxWidth, int maxHeight, int maxFrameCount, int maxCommandCount, bool useNewExecute,
+                           bool isCompress, const ConvertOptions &options)
+{
+    cv::VideoCapture video(videoPath);
+    std::optional<Mcpack::PackDir> pack = makeFunctionPack(video, matcher, manifest, plane, maxWidth, maxHeight,
+                                                           maxFrameCount, maxCommandCount, useNewExecute, options);
+    if (pack)
+        pack->write(outputPath, isCompress, options.zipLevels, options.threadCount);
+}
+
+void makeVideoFunctionPack(const std::string &videoPath, const std::string &outputPath,
+                           BIModis &modis, const Mcpack::PackManifest &manifest, Plane plane,
+                           int maxWidth, int maxHeight, int maxFrameCount, int maxCommandCount, bool useNewExecute,
+                           bool isCompress, const ConvertOptions &options)
+{
+    makeVideoFunctionPack(videoPath, outputPath, Quantizer::Matcher(modis), manifest, plane, maxWidth, maxHeight,
+                          maxFrameCount, maxCommandCount, useNewExecute, isCompress, options);
+}
+
+void makeImageStructurePack(const std::string &imgPath, const std::string &outputPath,
+                            const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest, Plane plane,
+                            int maxWidth, int maxHeight, bool isCompress, const ConvertOptions &options)
 {
     cv::Mat img = cv::imread(imgPath);
-    Bf::Dir dir = makeFunctionPack(img, modis, manifest, plane, maxWidth, maxHeight, maxCommandCount,
-                                   useNewExecute);
-    dir.write(outputPath, Bf::Override);
-    if (isCompress) {
-        compressFolder(outputPath + "/" + dir.name(), outputPath + "/" + dir.name() + ".mcpack");
-        Bf::deleteDirectory(outputPath + "/" + dir.name());
-    }
+    Mcpack::PackDir pack = makeStructurePack(img, matcher, manifest, plane, maxWidth, maxHeight, options);
+    pack.write(outputPath, isCompress, options.zipLevels, options.threadCount);
 }
 
 void makeImageStructurePack(const std::string &imgPath, const std::string &outputPath,
                             BIModis &modis, const Mcpack::PackManifest &manifest, Plane plane,
-                            int maxWidth, int maxHeight, bool isCompress)
+                            int maxWidth, int maxHeight, bool isCompress, const ConvertOptions &options)
 {
-    cv::Mat img = cv::imread(imgPath);
-    Bf::Dir dir = makeStructurePack(img, modis, manifest, plane, maxWidth, maxHeight);
-    dir.write(outputPath, Bf::Override);
-    if (isCompress) {
-        compressFolder(outputPath + "/" + dir.name(), outputPath + "/" + dir.name() + ".mcpack");
-        Bf::deleteDirectory(outputPath + "/" + dir.name());
-    }
+    makeImageStructurePack(imgPath, outputPath, Quantizer::Matcher(modis), manifest, plane, maxWidth, maxHeight,
+                           isCompress, options);
 }
 
 void makeVideoStructurePack(const std::string &videoPath, const std::string &outputPath,
-                            BIModis &modis, const Mcpack::PackManifest &manifest, Plane plane,
+                            const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest, Plane plane,
                             int maxWidth, int maxHeight, int maxFrameCount, bool detachFrame,
-                            bool isCompress)
+                            bool isCompress, const ConvertOptions &options)
 {
     cv::VideoCapture video(videoPath);
-    Bf::Dir dir = makeStructurePack(video, modis, manifest, plane, maxWidth, maxHeight,
-                                    maxFrameCount, detachFrame);
-    dir.write(outputPath, Bf::Override);
-    if (isCompress) {
-        compressFolder(outputPath + "/" + dir.name(), outputPath + "/" + dir.name() + ".mcpack");
-        Bf::deleteDirectory(outputPath + "/" + dir.name());
-    }
+    Mcpack::PackDir pack = makeStructurePack(video, matcher, manifest, plane, maxWidth, maxHeight,
+                                             maxFrameCount, detachFrame, options);
+    pack.write(outputPath, isCompress, options.zipLevels, options.threadCount);
 }
 
+void makeVideoStructurePack(const std::string &videoPath, const std::string &outputPath,
+                            BIModis &modis, const Mcpack::PackManifest &manifest, Plane plane,
+                            int maxWidth, int maxHeight, int maxFrameCount, bool detachFrame,
+                            bool isCompress, const ConvertOptions &options)
+{
+    makeVideoStructurePack(videoPath, outputPath, Quantizer::Matcher(modis), manifest, plane, maxWidth, maxHeight,
+                           maxFrameCount, detachFrame, isCompress, options);
+}
@@ -1,10 +1,15 @@
 #ifndef MODULES_HPP
 #define MODULES_HPP
 
+#include <cstddef>
 #include <string>
 
 #include "preprocess.hpp"
+#include "block_db.hpp"
+#include "palette_registry.hpp"
 #include "mcpack.hpp"
+#include "quantizer.hpp"
+#include "texture_atlas.hpp"
 
 enum Plane
 {
@@ -13,24 +18,144 @@ enum Plane
     XZ_Y
 };
 
+// The layouts of the block image files.
+enum class ImageLayout : char
+{
+    // A single image, name_BlockImage.jpg.
+    Whole,
+    // The horizontal strips from the top, name_BlockImage_<i>.jpg.
+    Strips,
+    // The Deep Zoom pyramid, name_BlockImage.dzi and the tiles name_BlockImage_files/<level>/<col>_<row>.jpg.
+    DeepZoom
+};
+
+// The statistics of the conversion, the counts are accumulated.
+struct ConvertStats
+{
+    // The fill commands count if only the same blocks in a row are merged.
+    std::size_t commandsBeforeMerge = 0;
+    // The fill commands count after merging the same blocks into the boxes.
+    std::size_t commandsAfterMerge = 0;
+    // The count of the video frames which are stored as the changes of the previous frame.
+    std::size_t deltaFrameCount = 0;
+    // The count of the video frames which reuse the structures of an earlier frame, or which have no change.
+    std::size_t dedupFrameCount = 0;
+    // The pixels of the video frames which are looked up in the temporal cache, and which reuse the previous result.
+    std::size_t cacheLookups = 0;
+    std::size_t cacheHits = 0;
+};
+
+// The tuning options of the conversion.
+struct ConvertOptions
+{
+    // The worker count of the pixel mapping, 0 means the hardware concurrency.
+    // The result is the same for any count.
+    int threadCount = 0;
+    // The chunk size of the block storage, 0 means the flat grid. The chunked storage only allocates the chunks
+    // which have different blocks, it is for the large areas such as the stacked video frames.
+    int chunkSize = 0;
+    // The frames interval of the full video frames when the frames are detached, 0 means every frame is full.
+    // The other frames only store the changed blocks of the previous frame, split by the tiles.
+    int keyframeInterval = 0;
+    // The tile size along the width and height of the delta frames.
+    int deltaTileSize = 16;
+    // Whether the detached video frames which are the same as an earlier full frame or similar to the previous frame
+    // reuse its structures.
+    bool dedupFrames = false;
+    // The max ratio of the different blocks that a frame is still similar to the previous frame, 0 means the same.
+    double dedupTolerance = 0;
+    // The max difference of a color channel that a video pixel reuses the block of the same pixel in the previous
+    // frame, negative means no reuse and 0 means only the same color reuses it.
+    int temporalTolerance = -1;
+    // The frame rate of the video frames to convert, the frames are picked evenly from the source.
+    // 0 means every source frame, 20 matches the game ticks. It is at most the source frame rate, the frames are
+    // never repeated.
+    double targetFps = 0;
+    // The time range of the video to convert in seconds, the endTime 0 means the end of the video.
+    double startTime = 0;
+    double endTime = 0;
+    // The count of the detached video frames which are converted at the same time, 0 means the hardware
+    // concurrency. With more than one, every frame is mapped on one thread. It is 1 if the temporal cache is
+    // enabled, the cache needs the frames in order.
+    int frameWorkers = 1;
+    // The max count of the detached video frames in flight, 0 means twice the frame workers.
+    int frameWindow = 0;
+    // The layout of the block image, the strips and the tiles are rendered one by one, so the memory is bounded.
+    ImageLayout imageLayout = ImageLayout::Whole;
+    // The strip height or the tile size of the block image in pixels, 0 means 256.
+    int imageTileSize = 256;
+    // The deflate levels of the .mcpack entries.
+    ZipLevels zipLevels;
+    // Receives the statistics if it is not null.
+    ConvertStats *stats = nullptr;
+};
+
 BIModis filterBIRaws(const BIRaws &raws, Plane plane, int attribute, Version version);
 
+// @brief Filters the compiled block infos without decoding them, the result is the same as filterBIRaws().
+BIModis filterBIRaws(const BlockDb &db, Plane plane, int attribute, Version version);
+
+// @brief Gets the shared palette and matcher of the plane, they are made once per registry.
+std::shared_ptr<const PaletteView> getPaletteView(PaletteRegistry &registry, Plane plane, int attribute,
+                                                  Version version, int type = 0);
+
+// @note The overloads with the matcher can reuse a prebuilt or loaded lookup table of the palette,
+//       see Quantizer::ColorLut.
+void makeBlockImage(const std::string &imgPath, const std::string &outputPath,
+                           const Quantizer::Matcher &matcher, const std::string &texturePath, int maxWidth, int maxHeight,
+                           std::unordered_map<std::string, int> *blocksInfo = nullptr,
+                           const ConvertOptions &options = ConvertOptions());
+
+// @note The atlas must be loaded from the palette of the matcher, it can be shared by the jobs.
+void makeBlockImage(const std::string &imgPath, const std::string &outputPath,
+                           const Quantizer::Matcher &matcher, const TextureAtlas &atlas, int maxWidth, int maxHeight,
+                           std::unordered_map<std::string, int> *blocksInfo = nullptr,
+                           const ConvertOptions &options = ConvertOptions());
+
 void makeBlockImage(const std::string &imgPath, const std::string &outputPath,
                            BIModis &modis, const std::string &texturePath, int maxWidth, int maxHeight,
-                           std::unordered_map<std::string, int> *blocksInfo = nullptr);
+                           std::unordered_map<std::string, int> *blocksInfo = nullptr,
+                           const ConvertOptions &options = ConvertOptions());
+
+void makeImageFunctionPack(const std::string &imgPath, const std::string &outputPath,
+                                  const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest, Plane plane,
+                                  int maxWidth, int maxHeight, int maxCommandCount, bool useNewExecute,
+                                  bool isCompress, const ConvertOptions &options = ConvertOptions());
 
 void makeImageFunctionPack(const std::string &imgPath, const std::string &outputPath,
                                   BIModis &modis, const Mcpack::PackManifest &manifest, Plane plane,
                                   int maxWidth, int maxHeight, int maxCommandCount, bool useNewExecute,
-                                  bool isCompress);
+                                  bool isCompress, const ConvertOptions &options = ConvertOptions());
+
+// @note Plays a frame per tick, the frames after the first only fill the changed blocks.
+void makeVideoFunctionPack(const std::string &videoPath, const std::string &outputPath,
+                                  const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest, Plane plane,
+                                  int maxWidth, int maxHeight, int maxFrameCount, int maxCommandCount,
+                                  bool useNewExecute, bool isCompress, const ConvertOptions &options = ConvertOptions());
+
+void makeVideoFunctionPack(const std::string &videoPath, const std::string &outputPath,
+                                  BIModis &modis, const Mcpack::PackManifest &manifest, Plane plane,
+                                  int maxWidth, int maxHeight, int maxFrameCount, int maxCommandCount,
+                                  bool useNewExecute, bool isCompress, const ConvertOptions &options = ConvertOptions());
+
+void makeImageStructurePack(const std::string &imgPath, const std::string &outputPath,
+                                   const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest, Plane plane,
+                                   int maxWidth, int maxHeight, bool isCompress,
+                                   const ConvertOptions &options = ConvertOptions());
 
 void makeImageStructurePack(const std::string &imgPath, const std::string &outputPath,
                                    BIModis &modis, const Mcpack::PackManifest &manifest, Plane plane,
-                                   int maxWidth, int maxHeight, bool isCompress);
+                                   int maxWidth, int maxHeight, bool isCompress,
+                                   const ConvertOptions &options = ConvertOptions());
+
+void makeVideoStructurePack(const std::string &imgPath, const std::string &outputPath,
+                                   const Quantizer::Matcher &matcher, const Mcpack::PackManifest &manifest, Plane plane,
+                                   int maxWidth, int maxHeight, int maxFrameCount, bool detachFrame,
+                                   bool isCompress, const ConvertOptions &options = ConvertOptions());
 
 void makeVideoStructurePack(const std::string &imgPath, const std::string &outputPath,
                                    BIModis &modis, const Mcpack::PackManifest &manifest, Plane plane,
                                    int maxWidth, int maxHeight, int maxFrameCount, bool detachFrame,
-                                   bool isCompress);
+                                   bool isCompress, const ConvertOptions &options = ConvertOptions());
 
 #endif // !MOUDLES_HPP
@@ -0,0 +1,58 @@
+#include "palette_registry.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+std::shared_ptr<const PaletteView> PaletteRegistry::get(int face, int alignment, int attribute, Version version,
+                                                        int type) {
+    Key key(face, alignment, attribute, version.data(), type);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = views_.find(key);
+        if (it != views_.end())
+            return it->second;
+    }
+    // Makes the view without the lock, the first one is kept if two threads make the same view.
+    auto view = make(face, alignment, attribute, version, type);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return views_.emplace(key, view).first->second;
+}
+
+std::size_t PaletteRegistry::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return views_.size();
+}
+
+std::shared_ptr<const PaletteView> PaletteRegistry::make(int face, int alignment, int attribute, Version version,
+                                                         int type) const {
+    BIModis modis;
+    if (!db_.empty())
+        modis = db_.modis(face, alignment, attribute, version);
+    else if (!raws_.empty())
+        modis = rawsToModis(raws_, face, alignment, attribute, version);
+    auto view = std::make_shared<PaletteView>(std::move(modis), type);
+    if (view->modis.empty())
+        return view;
+
+    if (options_.lutBits > 0) {
+        std::string lutPath;
+        if (!options_.lutDir.empty()) {
+            std::ostringstream name;
+            name << options_.lutDir << "/palette_" << std::hex << std::setw(16) << std::setfill('0') <<
+                Quantizer::paletteHash(view->modis) << std::dec << "_" << type << "_" << options_.lutBits << ".lut";
+            lutPath = name.str();
+        }
+        Quantizer::ColorLut lut;
+        if (!lutPath.empty())
+            lut = Quantizer::ColorLut::load(lutPath, view->modis, type);
+        if (lut.empty() || lut.bits() != options_.lutBits) {
+            lut = Quantizer::ColorLut::build(view->modis, type, options_.lutBits, options_.threadCount);
+            if (!lutPath.empty() && !lut.empty())
+                lut.save(lutPath);
+        }
+        view->matcher.setLut(lut);
+    }
+    if (options_.useKdTree && view->matcher.lut().empty())
+        view->matcher.setKdTree(std::make_shared<const Quantizer::KdTree>(view->modis, type));
+    return view;
+}
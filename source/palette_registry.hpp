@@ -0,0 +1,73 @@
+#ifndef PALETTE_REGISTRY_HPP
+#define PALETTE_REGISTRY_HPP
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "preprocess.hpp"
+#include "block_db.hpp"
+#include "quantizer.hpp"
+
+// @brief The filtered palette with its search structures, it is immutable after it is made.
+struct PaletteView
+{
+    PaletteView(BIModis modis, int type) : modis(std::move(modis)), matcher(this->modis, type) {}
+
+    PaletteView(const PaletteView &) = delete;
+    PaletteView &operator=(const PaletteView &) = delete;
+
+    const BIModis modis;
+    // Searches the modis, the table or the index is set if the registry builds them.
+    Quantizer::Matcher matcher;
+};
+
+// The search structures that the registry makes for the views.
+struct PaletteOptions
+{
+    // The bits of the color table which is set to the matchers, 0 means no table.
+    int lutBits = 0;
+    // The directory of the saved tables, they are loaded instead of built if it is not empty.
+    std::string lutDir;
+    // Sets the nearest search index to the matchers when they have no table.
+    bool useKdTree = false;
+    // The worker count of building the tables, 0 means the hardware concurrency.
+    int threadCount = 0;
+};
+
+// @brief Makes every filtered palette once and shares it between the jobs.
+// @note The views are keyed by the face, alignment, attribute mask, version and similarity type.
+//       It is safe to get the views from multiple threads.
+class PaletteRegistry
+{
+public:
+    explicit PaletteRegistry(const BlockDb &db, const PaletteOptions &options = PaletteOptions()) :
+        db_(db), options_(options) {}
+    explicit PaletteRegistry(BIRaws raws, const PaletteOptions &options = PaletteOptions()) :
+        raws_(std::move(raws)), options_(options) {}
+
+    PaletteRegistry(const PaletteRegistry &) = delete;
+    PaletteRegistry &operator=(const PaletteRegistry &) = delete;
+
+    // @brief Gets the view of the filter, it is made on the first request.
+    std::shared_ptr<const PaletteView> get(int face, int alignment, int attribute, Version version, int type = 0);
+
+    // @brief The count of the made views.
+    std::size_t size() const;
+
+private:
+    using Key = std::tuple<int, int, int, int, int>;
+
+    std::shared_ptr<const PaletteView> make(int face, int alignment, int attribute, Version version,
+                                            int type) const;
+
+    BlockDb db_;
+    BIRaws raws_;
+    PaletteOptions options_;
+    mutable std::mutex mutex_;
+    std::map<Key, std::shared_ptr<const PaletteView>> views_;
+};
+
+#endif // !PALETTE_REGISTRY_HPP
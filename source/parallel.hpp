@@ -0,0 +1,162 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// @brief Gets the usable worker count.
+// @param threadCount The wanted count, 0 or negative means the hardware concurrency.
+inline int workerCount(int threadCount) {
+    if (threadCount > 0)
+        return threadCount;
+    int hardware = static_cast<int>(std::thread::hardware_concurrency());
+    return hardware > 0 ? hardware : 1;
+}
+
+// @brief Splits [begin, end) into contiguous ranges and calls func(rangeBegin, rangeEnd, worker) for each range.
+// @param threadCount The worker count, 0 or negative means the hardware concurrency.
+// @note The ranges only depend on the arguments, the calling thread runs the first range.
+template<typename Func>
+inline void parallelFor(int begin, int end, int threadCount, Func func) {
+    if (end <= begin)
+        return;
+    int workers = std::min(workerCount(threadCount), end - begin);
+    if (workers <= 1) {
+        func(begin, end, 0);
+        return;
+    }
+    int step = (end - begin) / workers;
+    int remain = (end - begin) % workers;
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    int from = begin;
+    int firstTo = 0;
+    for (int i = 0; i < workers; ++i) {
+        int to = from + step + (i < remain ? 1 : 0);
+        if (i == 0)
+            firstTo = to;
+        else
+            threads.emplace_back(func, from, to, i);
+        from = to;
+    }
+    func(begin, firstTo, 0);
+    for (auto &thread : threads)
+        thread.join();
+}
+
+// @brief The first in first out queue between the pipeline stages, the producer waits when it is full.
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // @return False if the queue is closed, the item is dropped.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return items_.size() < capacity_ || closed_; });
+        if (closed_)
+            return false;
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // @return False if the queue is closed and empty.
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty())
+            return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // @brief No more items will be pushed, the consumers get the remaining items then stop.
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+private:
+    std::deque<T> items_;
+    std::size_t capacity_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+};
+
+// @brief Collects the items of the workers and gives them in the index order, from 0.
+// @note The producer reserves the index before the work, at most window indices are reserved and not popped,
+//       so the items in flight are capped.
+template<typename T>
+class OrderedQueue
+{
+public:
+    explicit OrderedQueue(int window) : window_(window > 0 ? window : 1) {}
+
+    OrderedQueue(const OrderedQueue &) = delete;
+    OrderedQueue &operator=(const OrderedQueue &) = delete;
+
+    // @brief Waits until the index is in the window.
+    // @return False if the queue is closed.
+    bool reserve(int index) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this, index] { return index < next_ + window_ || closed_; });
+        return !closed_;
+    }
+
+    // @brief Adds the item of the reserved index.
+    void push(int index, T item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        items_.emplace(index, std::move(item));
+        if (index == next_)
+            ready_.notify_all();
+    }
+
+    // @return False if the queue is closed and the next item will never come.
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return items_.count(next_) != 0 || closed_; });
+        auto it = items_.find(next_);
+        if (it == items_.end())
+            return false;
+        item = std::move(it->second);
+        items_.erase(it);
+        ++next_;
+        notFull_.notify_all();
+        return true;
+    }
+
+    // @brief No more items will be pushed, the consumer gets the items in order until a gap.
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        ready_.notify_all();
+        notFull_.notify_all();
+    }
+
+private:
+    std::map<int, T> items_;
+    int window_;
+    int next_ = 0;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable notFull_;
+};
+
+#endif // !PARALLEL_HPP
@@ -2,7 +2,12 @@
 
 #include <cmath>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <vector>
 #include <fstream>
 
@@ -14,15 +19,21 @@
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/prettywriter.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/error/en.h>
+
+#include "mapped_file.hpp"
+#include "parallel.hpp"
 
 #undef GetObject
 
 static inline std::string byteToHexstr(unsigned char num, bool isUppercase = true, bool justify = true) {
     std::stringstream ss;
     if (isUppercase)
-        ss << std::uppercase << std::hex << num;
+        ss << std::uppercase << std::hex << static_cast<int>(num);
     else
-        ss << std::hex << num;
+        ss << std::hex << static_cast<int>(num);
     std::string str = ss.str();
     if (justify && str.size() % 2 != 0)
         str.insert(0, "0");
@@ -68,13 +79,9 @@ static inline cv::Vec3b getAverageColor(const cv::Mat &image) {
         std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "The image is invalid." << std::endl;
         return cv::Vec3b(0, 0, 0);
     }
-    int totalPixel = static_cast<int>(image.total());
-    cv::Mat img = image.reshape(0, totalPixel);
-    img.convertTo(img, CV_8UC3);
-    cv::Vec3d sum(0.0, 0.0, 0.0);
-    for (int i = totalPixel - 1; i >= 0; --i)
-        sum += img.at<cv::Vec3b>(i, 0);
-    return sum / totalPixel;
+    cv::Scalar mean = cv::mean(image);
+    return cv::Vec3b(cv::saturate_cast<unsigned char>(mean[0]), cv::saturate_cast<unsigned char>(mean[1]),
+                     cv::saturate_cast<unsigned char>(mean[2]));
 }
 
 // @brief Gets the theme color of the image by Kmeans algorithm and show.
@@ -177,7 +184,7 @@ static inline BlockInfoRaw _getBIRawByJsonObj(const rapidjson::Value &object) {
         Version version = Version(obj[PREPROC_KW_VERS].GetArray()[0].GetInt(),
                                   obj[PREPROC_KW_VERS].GetArray()[1].GetInt(),
                                   obj[PREPROC_KW_VERS].GetArray()[2].GetInt());
-        result.ids.insert({ version, id });
+        result.addId(version, id);
     }
     // Get the aligmnet info of the block.
     for (auto &alignment : alignments.GetArray()) {
@@ -193,7 +200,7 @@ static inline BlockInfoRaw _getBIRawByJsonObj(const rapidjson::Value &object) {
             continue;
         std::string key = textureName.name.GetString();
         std::string value = textureName.value.GetString();
-        result.facesTexturePath.insert({ _getFaceByStr(key), value });
+        result.setTexture(_getFaceByStr(key), value);
     }
     // Get the main color of the block different faces.
     for (auto &color : facesColor.GetObject()) {
@@ -201,7 +208,7 @@ static inline BlockInfoRaw _getBIRawByJsonObj(const rapidjson::Value &object) {
             continue;
         std::string key = color.name.GetString();
         std::string value = color.value.GetString();
-        result.facesColor.insert({ _getFaceByStr(key), hexstrToRgb(value) });
+        result.setColor(_getFaceByStr(key), hexstrToRgb(value));
     }
     // Get the attribute of the block.
     for (std::size_t i = 0; i < attrStrs.size(); ++i) {
@@ -227,7 +234,9 @@ static inline BlockInfoRaw _getBIRawByJsonObj(const rapidjson::Value &object) {
     return result;
 }
 
-BIRaws getBIRawsByDomFile(const std::string &filepath) noexcept {
+// @brief Reads the file word by word and parses the DOM, which is the old way of loading.
+// @note It drops the spaces in the strings, only for the benchmark.
+static BIRaws getBIRawsByWordDom(const std::string &filepath) {
     std::ifstream file(filepath);
     std::string json;
     std::string line;
@@ -250,65 +259,352 @@ BIRaws getBIRawsByDomFile(const std::string &filepath) noexcept {
     return result;
 }
 
+static inline int _getAttributeByStr(const std::string &str) {
+    if (str == PREPROC_KW_ISLIGHTING)
+        return BlockFlag::IsLighting;
+    if (str == PREPROC_KW_ISTIMEVRAYING)
+        return BlockFlag::IsTimeVarying;
+    if (str == PREPROC_KW_BURNABLE)
+        return BlockFlag::Burnable;
+    if (str == PREPROC_KW_PICKABLE)
+        return BlockFlag::EndermanPickable;
+    if (str == PREPROC_KW_HASGRAVITY)
+        return BlockFlag::HasGravity;
+    if (str == PREPROC_KW_HASENERGY)
+        return BlockFlag::HasEnergy;
+    if (str == PREPROC_KW_ISTRANSPARENCY)
+        return BlockFlag::IsTransparency;
+    if (str == PREPROC_KW_ISCOMMANDFORMATId)
+        return BlockFlag::IsCommandFormatId;
+    return 0;
+}
+
+static inline void setVersionPart(Version &version, int part, int value) {
+    if (part == 0)
+        version.major = static_cast<unsigned char>(value);
+    else if (part == 1)
+        version.minor = static_cast<unsigned char>(value);
+    else if (part == 2)
+        version.patch = static_cast<unsigned char>(value);
+}
+
+// The max nesting depth of the recorded keys, the block infos are not deeper than it.
+constexpr int _MaxJsonDepth = 8;
+
+// @brief Builds the block infos from the SAX events, the unknown values are skipped.
+// @note The depth 1 is the root object, 2 is the blocks array, 3 is a block object, 5 is an id object.
+class BIRawsHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, BIRawsHandler>
+{
+public:
+    explicit BIRawsHandler(BIRaws &raws) : raws_(raws) {}
+
+    bool StartObject() {
+        enter();
+        if (depth_ == 3 && isInBlocks())
+            raw_ = BlockInfoRaw();
+        else if (depth_ == 5 && isInBlockKey(PREPROC_KW_IdS)) {
+            id_.clear();
+            version_ = Version();
+        }
+        return true;
+    }
+    bool EndObject(rapidjson::SizeType) {
+        if (depth_ == 3 && isInBlocks())
+            raws_.push_back(std::move(raw_));
+        else if (depth_ == 5 && isInBlockKey(PREPROC_KW_IdS))
+            raw_.addId(version_, id_);
+        --depth_;
+        return true;
+    }
+    bool StartArray() {
+        enter();
+        return true;
+    }
+    bool EndArray(rapidjson::SizeType) {
+        --depth_;
+        return true;
+    }
+    bool Key(const char *str, rapidjson::SizeType length, bool) {
+        if (depth_ < _MaxJsonDepth)
+            keys_[depth_].assign(str, length);
+        return true;
+    }
+
+    bool Bool(bool value) {
+        if (value && depth_ == 3 && isInBlocks())
+            raw_.attribute |= _getAttributeByStr(keys_[3]);
+        return true;
+    }
+    bool Int(int value) {
+        if (depth_ == 4 && isInBlockKey(PREPROC_KW_DEBUTVERS))
+            setVersionPart(raw_.debutVersion, indices_[4]++, value);
+        else if (depth_ == 6 && isInBlockKey(PREPROC_KW_IdS) && keys_[5] == PREPROC_KW_VERS)
+            setVersionPart(version_, indices_[6]++, value);
+        return true;
+    }
+    bool Uint(unsigned value) {
+        return Int(static_cast<int>(value));
+    }
+    bool String(const char *str, rapidjson::SizeType length, bool) {
+        if (depth_ == 4 && isInBlocks()) {
+            std::string value(str, length);
+            if (keys_[3] == PREPROC_KW_TEXS)
+                raw_.setTexture(_getFaceByStr(keys_[4]), value);
+            else if (keys_[3] == PREPROC_KW_COLORS)
+                raw_.setColor(_getFaceByStr(keys_[4]), hexstrToRgb(value));
+            else if (keys_[3] == PREPROC_KW_ALIGNMENT && value == PREPROC_KW_X)
+                raw_.alignment |= BlockFlag::Horizontal;
+            else if (keys_[3] == PREPROC_KW_ALIGNMENT && value == PREPROC_KW_Y)
+                raw_.alignment |= BlockFlag::Vertical;
+        }
+        else if (depth_ == 5 && isInBlockKey(PREPROC_KW_IdS) && keys_[5] == PREPROC_KW_Id) {
+            id_.assign(str, length);
+        }
+        return true;
+    }
+
+private:
+    void enter() {
+        ++depth_;
+        if (depth_ < _MaxJsonDepth) {
+            keys_[depth_].clear();
+            indices_[depth_] = 0;
+        }
+    }
+    bool isInBlocks() const {
+        return depth_ >= 3 && keys_[1] == PREPROC_KW_ROOT;
+    }
+    bool isInBlockKey(const char *key) const {
+        return isInBlocks() && keys_[3] == key;
+    }
+
+    BIRaws &raws_;
+    BlockInfoRaw raw_;
+    std::string id_;
+    Version version_;
+    int depth_ = 0;
+    // The last key of the objects and the next element index of the arrays, by the depth.
+    std::string keys_[_MaxJsonDepth];
+    int indices_[_MaxJsonDepth] = {};
+};
+
+BIRaws getBIRawsByDomFile(const std::string &filepath) noexcept {
+    MappedFile file(filepath);
+    if (!file.isOpen()) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Failed to open file." << std::endl;
+        return BIRaws();
+    }
+    const char *data = file.data();
+    std::size_t size = file.size();
+    // Skips the UTF-8 BOM.
+    if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        data += 3;
+        size -= 3;
+    }
+
+    BIRaws result;
+    BIRawsHandler handler(result);
+    rapidjson::Reader reader;
+    rapidjson::MemoryStream stream(data, size);
+    rapidjson::ParseResult parsed = reader.Parse<rapidjson::kParseDefaultFlags>(stream, handler);
+    if (parsed.IsError()) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Failed to parse file, " <<
+            rapidjson::GetParseError_En(parsed.Code()) << " at " << parsed.Offset() << "." << std::endl;
+        return BIRaws();
+    }
+    return result;
+}
+
+static bool isSameBIRaw(const BlockInfoRaw &lhs, const BlockInfoRaw &rhs) {
+    if (lhs.ids != rhs.ids || lhs.textureMask != rhs.textureMask || lhs.colorMask != rhs.colorMask ||
+        !(lhs.debutVersion == rhs.debutVersion) || lhs.alignment != rhs.alignment || lhs.attribute != rhs.attribute)
+        return false;
+    for (int slot = 0; slot < BlockFlag::_FaceSlotCount; ++slot) {
+        if (lhs.hasTexture(slot) && lhs.facesTexturePath[slot] != rhs.facesTexturePath[slot])
+            return false;
+        if (lhs.hasColor(slot) && !(lhs.facesColor[slot] == rhs.facesColor[slot]))
+            return false;
+    }
+    return true;
+}
+
+LoadBenchmark benchmarkBIRawsLoad(const std::string &filepath, int repeatCount) {
+    LoadBenchmark result;
+    if (repeatCount <= 0)
+        return result;
+    std::error_code error;
+    result.fileSize = static_cast<std::size_t>(std::filesystem::file_size(filepath, error));
+
+    BIRaws wordRaws;
+    BIRaws mappedRaws;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeatCount; ++i)
+        wordRaws = getBIRawsByWordDom(filepath);
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeatCount; ++i)
+        mappedRaws = getBIRawsByDomFile(filepath);
+    auto end = std::chrono::steady_clock::now();
+    result.wordDom = std::chrono::duration<double, std::milli>(middle - start).count() / repeatCount;
+    result.mappedSax = std::chrono::duration<double, std::milli>(end - middle).count() / repeatCount;
+
+    result.blockCount = static_cast<int>(mappedRaws.size());
+    std::size_t count = std::min(wordRaws.size(), mappedRaws.size());
+    result.mismatched = static_cast<int>(std::max(wordRaws.size(), mappedRaws.size()) - count);
+    for (std::size_t i = 0; i < count; ++i)
+        result.mismatched += isSameBIRaw(wordRaws[i], mappedRaws[i]) ? 0 : 1;
+    return result;
+}
+
+bool PaletteFilter::pick(int blockAlignment, int blockAttribute, const Version &blockDebutVersion, int textureMask,
+                         int colorMask, int &textureSlot, int &colorSlot) const {
+    if (!(blockAlignment & alignment))
+        return false;
+    if (blockDebutVersion < debutVersion)
+        return false;
+    if ((blockAttribute & attribute) != blockAttribute)
+        return false;
+    int colorFaces = 0;
+    for (int s = 0; s < BlockFlag::_FaceSlotCount; ++s) {
+        if (colorMask >> s & 1)
+            colorFaces |= BlockFlag::slotFace(s);
+    }
+    if ((face & colorFaces) == 0)
+        return false;
+    if (blockAlignment == (BlockFlag::Vertical | BlockFlag::Horizontal) && (colorMask & (colorMask - 1)) == 0) {
+        // The block looks the same in every face, takes its only color and the texture of that face.
+        colorSlot = BlockFlag::lowestSlot(colorMask);
+        textureSlot = textureMask >> colorSlot & 1 ? colorSlot : BlockFlag::lowestSlot(textureMask);
+        return textureSlot >= 0;
+    }
+    if (slot < 0 || !(textureMask >> slot & 1) || !(colorMask >> slot & 1))
+        return false;
+    textureSlot = slot;
+    colorSlot = slot;
+    return true;
+}
+
 BIModis rawsToModis(const BIRaws &raws, int face, int alignment, int attribute,
                     Version debutVersion) {
     assert(!raws.empty());
     BIModis result;
+    PaletteFilter filter(face, alignment, attribute, debutVersion);
     for (auto &raw : raws) {
-        int faceFlag = 0;
-        for (auto &var : raw.facesColor)
-            faceFlag |= var.first;
-        if (!(raw.alignment & alignment))
-            continue;
-        if (raw.debutVersion < debutVersion)
-            continue;
-        if((raw.attribute & attribute) != raw.attribute)
+        int textureSlot = 0;
+        int colorSlot = 0;
+        if (!filter.pick(raw.alignment, raw.attribute, raw.debutVersion, raw.textureMask, raw.colorMask,
+                         textureSlot, colorSlot))
             continue;
-        if ((face & faceFlag) == 0)
-            continue;
-        std::string blockId;
-        std::string textureName;
-        Rgb color;
-        for (auto &var : raw.ids) {
-            if (debutVersion > var.first)
-                continue;
-            blockId = var.second;
-            break;
-        }
-        if (raw.alignment == (BlockFlag::Vertical | BlockFlag::Horizontal) &&
-            raw.facesColor.size() == 1) {
-            textureName = (*raw.facesTexturePath.begin()).second;
-            color = (*raw.facesColor.begin()).second;
-        } else {
-            if (raw.facesTexturePath.find(static_cast<BlockFlag::Faces>(face)) == raw.facesTexturePath.end())
-                continue;
-            textureName = raw.facesTexturePath.at(static_cast<BlockFlag::Faces>(face));
-            if (raw.facesColor.find(static_cast<BlockFlag::Faces>(face)) == raw.facesColor.end())
-                continue;
-            color = raw.facesColor.at(static_cast<BlockFlag::Faces>(face));
-        }
-        result.emplace_back(BlockInfoModified(blockId, textureName, color));
+        const std::string *blockId = raw.findId(debutVersion);
+        result.emplace_back(BlockInfoModified(blockId != nullptr ? *blockId : std::string(),
+                                              raw.facesTexturePath[textureSlot], raw.facesColor[colorSlot]));
     }
     return result;
 }
 
-bool textureAndblockIdHandle(const std::string &textureDirPath, const std::string &blockInfosFilePath)
+// The cached color of a texture file, it is valid while the file size and modification time are the same,
+// or the content hash is the same.
+struct TextureColorEntry
 {
-    std::ifstream blockInfosFileIn;
-    std::vector<std::string> files = Bf::getAllFiles(textureDirPath);
-    blockInfosFileIn.open(blockInfosFilePath);
-    if (!blockInfosFileIn.is_open()) {
-        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Failed to open file." << std::endl;
+    std::uint64_t size = 0;
+    std::int64_t time = 0;
+    std::uint64_t hash = 0;
+    Rgb color;
+};
+using TextureColorCache = std::unordered_map<std::string, TextureColorEntry>;
+
+// @brief Loads the sidecar cache, every line is the size, time, hash, color and name of a texture.
+static TextureColorCache loadTextureColorCache(const std::string &filepath) {
+    TextureColorCache cache;
+    std::ifstream file(filepath);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        TextureColorEntry entry;
+        std::string color;
+        std::string name;
+        if (!(stream >> entry.size >> entry.time >> std::hex >> entry.hash >> std::dec >> color))
+            continue;
+        stream.get();
+        if (!std::getline(stream, name) || name.empty())
+            continue;
+        entry.color = hexstrToRgb(color);
+        cache[name] = entry;
+    }
+    return cache;
+}
+
+static bool saveTextureColorCache(const std::string &filepath, const TextureColorCache &cache) {
+    std::ofstream file(filepath);
+    if (!file.is_open())
         return false;
+    for (auto &var : cache) {
+        file << var.second.size << ' ' << var.second.time << ' ' << std::hex << var.second.hash << std::dec << ' ' <<
+            rgbToHexstr(var.second.color) << ' ' << var.first << '\n';
     }
-    std::string json;
-    std::string line;
-    while (blockInfosFileIn >> line)
-        json += line;
-    blockInfosFileIn.close();
+    return file.good();
+}
+
+static std::uint64_t bytesHash(const std::string &bytes) {
+    // FNV-1a.
+    std::uint64_t hash = 14695981039346656037ull;
+    for (char ch : bytes) {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// @brief Gets the color of the texture, the file is only read if the cache entry is stale.
+// @return Whether the texture is valid, the entry is updated only if it is.
+static bool getTextureColor(const std::string &path, const TextureColorEntry *cached, TextureColorEntry &entry) {
+    std::error_code error;
+    auto size = std::filesystem::file_size(path, error);
+    auto time = error ? std::filesystem::file_time_type() : std::filesystem::last_write_time(path, error);
+    if (!error) {
+        entry.size = static_cast<std::uint64_t>(size);
+        entry.time = static_cast<std::int64_t>(time.time_since_epoch().count());
+        if (cached != nullptr && cached->size == entry.size && cached->time == entry.time) {
+            entry.hash = cached->hash;
+            entry.color = cached->color;
+            return true;
+        }
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    std::string bytes = stream.str();
+    entry.hash = bytesHash(bytes);
+    if (cached != nullptr && cached->hash == entry.hash && !bytes.empty()) {
+        entry.color = cached->color;
+        return true;
+    }
+    cv::Mat img;
+    if (!bytes.empty())
+        img = cv::imdecode(cv::Mat(1, static_cast<int>(bytes.size()), CV_8UC1, &bytes[0]), cv::IMREAD_COLOR);
+    if (img.empty()) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Failed to read " << path << "." <<
+            std::endl;
+        return false;
+    }
+    entry.color = bgrToRgb(getAverageColor(img));
+    return true;
+}
 
+bool textureAndblockIdHandle(const std::string &textureDirPath, const std::string &blockInfosFilePath,
+                             int threadCount)
+{
     rapidjson::Document dom;
-    dom.Parse(json.c_str());
+    {
+        MappedFile blockInfosFile(blockInfosFilePath);
+        if (!blockInfosFile.isOpen()) {
+            std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Failed to open file." <<
+                std::endl;
+            return false;
+        }
+        // The DOM copies the strings, so the file can be written after the mapping is released.
+        dom.Parse(blockInfosFile.data() != nullptr ? blockInfosFile.data() : "", blockInfosFile.size());
+    }
 
     assert(dom.IsObject());
     assert(dom.HasMember(PREPROC_KW_ROOT));
@@ -325,50 +621,73 @@ bool textureAndblockIdHandle(const std::string &textureDirPath, const std::strin
     if (!objs.IsArray())
         return false;
 
+    const char *faces[] = { PREPROC_KW_SIDE, PREPROC_KW_TOP };
+
+    // Collects the textures, every texture is only decoded once.
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> nameIndices;
     for (auto &obj : objs.GetArray()) {
         auto textures = obj.FindMember(PREPROC_KW_TEXS);
-        auto rgbs = obj.FindMember(PREPROC_KW_COLORS);
-        if (textures == obj.MemberEnd())
+        if (textures == obj.MemberEnd() || !textures->value.IsObject())
             continue;
-        if (rgbs == obj.MemberEnd()) {
+        for (const char *face : faces) {
+            auto texture = textures->value.FindMember(face);
+            if (texture == textures->value.MemberEnd() || !texture->value.IsString())
+                continue;
+            if (nameIndices.insert({ texture->value.GetString(), static_cast<int>(names.size()) }).second)
+                names.push_back(texture->value.GetString());
+        }
+    }
+
+    // Gets the colors on the workers, the cached textures are not decoded.
+    std::string cachePath = blockInfosFilePath + ".colors";
+    TextureColorCache cache = loadTextureColorCache(cachePath);
+    std::vector<TextureColorEntry> entries(names.size());
+    std::vector<char> isValid(names.size(), 0);
+    parallelFor(0, static_cast<int>(names.size()), threadCount, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            auto cached = cache.find(names[i]);
+            isValid[i] = getTextureColor(textureDirPath + '/' + names[i],
+                                         cached == cache.end() ? nullptr : &cached->second, entries[i]);
+        }
+    });
+    // Only the current textures are saved, so the textures which are no longer used are dropped.
+    TextureColorCache saved;
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        if (isValid[i])
+            saved.insert({ names[i], entries[i] });
+    }
+    if (!saveTextureColorCache(cachePath, saved))
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Failed to write the cache." <<
+            std::endl;
+
+    for (auto &obj : objs.GetArray()) {
+        if (obj.FindMember(PREPROC_KW_TEXS) == obj.MemberEnd())
+            continue;
+        if (obj.FindMember(PREPROC_KW_COLORS) == obj.MemberEnd()) {
             rapidjson::Value _rgbs(rapidjson::kObjectType);
             obj.AddMember(PREPROC_KW_COLORS, _rgbs, dom.GetAllocator());
         }
-        auto textureSide = textures->value.FindMember(PREPROC_KW_SIDE);
-        if (textureSide != textures->value.MemberEnd() &&
-            textureSide->value.IsString()) {
-            std::string path = textureDirPath + '\\' + textureSide->value.GetString();
-            cv::Mat img = cv::imread(path);
-            cv::Vec3b bgr = getAverageColor(img);
-            Rgb rgb = bgrToRgb(bgr);
-            std::string color = rgbToHexstr(rgb);
-            auto rgbSide = rgbs->value.FindMember(PREPROC_KW_SIDE);
-            if (rgbSide == rgbs->value.MemberEnd()) {
-                rapidjson::Value _rgbSide(rapidjson::kStringType);
-                rgbs->value.AddMember(PREPROC_KW_SIDE, _rgbSide, dom.GetAllocator());
-                rgbSide = rgbs->value.FindMember(PREPROC_KW_SIDE);
-            }
-            if (rgbSide->value.IsString()) {
-                rgbSide->value.SetString(color.c_str(), dom.GetAllocator());
-            }
-        }
-        auto textureTop = textures->value.FindMember(PREPROC_KW_TOP);
-        if (textureTop != textures->value.MemberEnd() &&
-            textureTop->value.IsString()) {
-            std::string path = textureDirPath + '\\' + textureTop->value.GetString();
-            cv::Mat img = cv::imread(path);
-            cv::Vec3b bgr = getAverageColor(img);
-            Rgb rgb = bgrToRgb(bgr);
-            std::string color = rgbToHexstr(rgb);
-            auto rgbTop = rgbs->value.FindMember(PREPROC_KW_TOP);
-            if (rgbTop == rgbs->value.MemberEnd()) {
-                rapidjson::Value _rgbTop(rapidjson::kStringType);
-                rgbs->value.AddMember(PREPROC_KW_TOP, _rgbTop, dom.GetAllocator());
-                rgbTop = rgbs->value.FindMember(PREPROC_KW_TOP);
-            }
-            if (rgbTop->value.IsString()) {
-                rgbTop->value.SetString(color.c_str(), dom.GetAllocator());
+        // Finds the members after the adding, it may move them.
+        auto &textures = obj[PREPROC_KW_TEXS];
+        auto &rgbs = obj[PREPROC_KW_COLORS];
+        if (!textures.IsObject() || !rgbs.IsObject())
+            continue;
+        for (const char *face : faces) {
+            auto texture = textures.FindMember(face);
+            if (texture == textures.MemberEnd() || !texture->value.IsString())
+                continue;
+            int index = nameIndices.at(texture->value.GetString());
+            // The invalid texture is black as before.
+            std::string color = rgbToHexstr(isValid[index] ? entries[index].color : Rgb());
+            auto rgb = rgbs.FindMember(face);
+            if (rgb == rgbs.MemberEnd()) {
+                rapidjson::Value _rgb(rapidjson::kStringType);
+                rgbs.AddMember(rapidjson::StringRef(face), _rgb, dom.GetAllocator());
+                rgb = rgbs.FindMember(face);
             }
+            if (rgb->value.IsString())
+                rgb->value.SetString(color.c_str(), dom.GetAllocator());
         }
     }
 
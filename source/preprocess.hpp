@@ -1,8 +1,13 @@
 #ifndef PREPROCESS_HPP
 #define PREPROCESS_HPP
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #ifndef PREPROCESS_MACRO
 #define PREPROCESS_MACRO
@@ -79,7 +84,7 @@ struct Rgb
     Rgb(unsigned char r, unsigned char g, unsigned char b) :
         r(r), g(g), b(b) {}
 
-    bool operator==(const Rgb &rhs) {
+    bool operator==(const Rgb &rhs) const {
         return r == rhs.r && g == rhs.g && b == rhs.b;
     }
 
@@ -159,13 +164,134 @@ enum Attribute : int
 
 }
 
+namespace BlockFlag
+{
+
+// The count of the face slots, Front to Bottom by the bit position, and Side.
+constexpr int _FaceSlotCount = 7;
+
+// @brief Gets the slot of the face, -1 if it is neither a single face nor Side.
+inline int faceSlot(int face) {
+    switch (face) {
+    case Front:
+        return 0;
+    case Back:
+        return 1;
+    case Right:
+        return 2;
+    case Left:
+        return 3;
+    case Top:
+        return 4;
+    case Bottom:
+        return 5;
+    case Side:
+        return 6;
+    default:
+        return -1;
+    }
+}
+
+inline Faces slotFace(int slot) {
+    return slot < 6 ? static_cast<Faces>(1 << slot) : Side;
+}
+
+// @brief Gets the first slot of the mask, -1 if the mask is empty.
+inline int lowestSlot(int mask) {
+    for (int slot = 0; slot < _FaceSlotCount; ++slot) {
+        if (mask >> slot & 1)
+            return slot;
+    }
+    return -1;
+}
+
+}
+
+// @brief Gets the first item of the range ascending by the version which is not below the version.
+template<typename It, typename VersionOf>
+inline It lowerVersion(It begin, It end, const Version &version, VersionOf versionOf) {
+    return std::lower_bound(begin, end, version, [&versionOf](const auto &lhs, const Version &rhs) {
+        return versionOf(lhs) < rhs;
+    });
+}
+
+// @brief The filter of the palette, it decides which face slots of a block are taken.
+// @note It is shared by rawsToModis() and BlockDb::modis(), so the block infos and the compiled ones give the same
+//       palette.
+struct PaletteFilter
+{
+    PaletteFilter(int face, int alignment, int attribute, Version debutVersion) :
+        face(face), alignment(alignment), attribute(attribute), debutVersion(debutVersion),
+        slot(BlockFlag::faceSlot(face)) {}
+
+    // @brief Picks the slots of the texture and the color of the block.
+    // @param textureMask, colorMask The face slots which have the texture or the color.
+    // @return false if the block is not in the palette.
+    bool pick(int blockAlignment, int blockAttribute, const Version &blockDebutVersion, int textureMask,
+              int colorMask, int &textureSlot, int &colorSlot) const;
+
+    int face = 0;
+    int alignment = 0;
+    int attribute = 0;
+    Version debutVersion;
+    // The slot of the face, -1 if the face is neither a single face nor Side.
+    int slot = -1;
+};
+
+// @note The faces are kept in the fixed slots and the ids are sorted by the version, so the filtering is a linear
+//       pass over the records without the hashing.
 struct BlockInfoRaw
 {
+    using VersionId = std::pair<Version, std::string>;
+
     BlockInfoRaw() {}
 
-    std::unordered_map<Version, std::string> ids;
-    std::unordered_map<BlockFlag::Faces, std::string> facesTexturePath;
-    std::unordered_map<BlockFlag::Faces, Rgb> facesColor;
+    // @brief Adds the id of the version, the first one is kept if the version has an id.
+    void addId(const Version &version, const std::string &id) {
+        auto it = std::lower_bound(ids.begin(), ids.end(), version,
+                                   [](const VersionId &lhs, const Version &rhs) { return lhs.first < rhs; });
+        if (it == ids.end() || !(it->first == version))
+            ids.insert(it, { version, id });
+    }
+    // @brief Gets the id of the lowest version which is not below the version, nullptr if there is none.
+    const std::string *findId(const Version &version) const {
+        auto it = lowerVersion(ids.begin(), ids.end(), version, [](const VersionId &id) { return id.first; });
+        return it == ids.end() ? nullptr : &it->second;
+    }
+
+    // @brief Sets the texture of the face, the first one is kept if the face has a texture.
+    void setTexture(BlockFlag::Faces face, const std::string &texturePath) {
+        int slot = BlockFlag::faceSlot(face);
+        if (slot < 0 || hasTexture(slot))
+            return;
+        facesTexturePath[slot] = texturePath;
+        textureMask |= 1 << slot;
+    }
+    // @brief Sets the color of the face, the first one is kept if the face has a color.
+    void setColor(BlockFlag::Faces face, const Rgb &color) {
+        int slot = BlockFlag::faceSlot(face);
+        if (slot < 0 || hasColor(slot))
+            return;
+        facesColor[slot] = color;
+        colorMask |= 1 << slot;
+        colorFaces |= face;
+    }
+    bool hasTexture(int slot) const {
+        return textureMask >> slot & 1;
+    }
+    bool hasColor(int slot) const {
+        return colorMask >> slot & 1;
+    }
+
+    // The ids ascending by the version.
+    std::vector<VersionId> ids;
+    // The textures and colors by the face slot, only the slots in the masks are valid.
+    std::array<std::string, BlockFlag::_FaceSlotCount> facesTexturePath;
+    std::array<Rgb, BlockFlag::_FaceSlotCount> facesColor;
+    unsigned char textureMask = 0;
+    unsigned char colorMask = 0;
+    // The faces which have the color.
+    int colorFaces = 0;
     Version debutVersion;
     char alignment = 0;
     int attribute = 0;
@@ -183,11 +309,34 @@ struct BlockInfoModified
 };
 using BIModis = std::vector<BlockInfoModified>;
 
+// @brief Loads the block infos, the file is mapped and parsed by the SAX events in a single pass.
+// @return The empty infos if the file can not be opened or parsed.
 BIRaws getBIRawsByDomFile(const std::string &filepath) noexcept;
 
+// The average load time of the block info file, in milliseconds.
+struct LoadBenchmark
+{
+    std::size_t fileSize = 0;
+    int blockCount = 0;
+    // Reads the file word by word and parses the DOM, which is the old way.
+    double wordDom = 0;
+    // Parses the mapped file by the SAX events.
+    double mappedSax = 0;
+    // The count of the blocks which the ways get the different infos, the old way drops the spaces in the strings.
+    int mismatched = 0;
+};
+
+// @brief Times the old and the current loading of the block info file.
+LoadBenchmark benchmarkBIRawsLoad(const std::string &filepath, int repeatCount = 5);
+
 BIModis rawsToModis(const BIRaws &raws, int face, int alignment, int attribute,
                     Version debutVersion);
 
-bool textureAndblockIdHandle(const std::string &textureDirPath, const std::string &blockInfosFilePath);
+// @brief Sets the side and top colors of the blocks by the average color of their textures.
+// @param threadCount The worker count of decoding the textures, 0 or negative means the hardware concurrency.
+// @note The colors are cached in the file which is the block info file path with ".colors", only the new or
+//       changed textures are decoded.
+bool textureAndblockIdHandle(const std::string &textureDirPath, const std::string &blockInfosFilePath,
+                             int threadCount = 0);
 
 #endif // !PREPROCESS_HPP
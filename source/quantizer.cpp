@@ -0,0 +1,747 @@
+#include "quantizer.hpp"
+
+#include <climits>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define QUANTIZER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define QUANTIZER_TARGET_SSE2
+#define QUANTIZER_TARGET_AVX2
+#else
+#define QUANTIZER_TARGET_SSE2 __attribute__((target("sse2")))
+#define QUANTIZER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif // _MSC_VER
+#endif
+
+namespace Quantizer
+{
+
+// The byte order tag of the table file, a file from a machine of the other byte order reads it swapped.
+constexpr std::uint32_t _LutByteOrder = 0x01020304;
+
+// The header of the table file, the table data follows it in the native byte order.
+struct LutFileHeader
+{
+    char magic[4] = { 'M', 'C', 'L', 'T' };
+    std::uint32_t formatVersion = 2;
+    std::uint32_t bits = 0;
+    std::int32_t type = 0;
+    std::uint32_t paletteSize = 0;
+    std::uint32_t byteOrder = _LutByteOrder;
+    std::uint64_t paletteHash = 0;
+};
+
+// The max count of the tied entries that a query records, the more falls back to the linear search.
+constexpr int _MaxTies = 64;
+
+static inline bool isValidType(int type) {
+    return type == 0 || type == 1;
+}
+
+// @brief Gets the center color value of the cell in a channel.
+static inline int cellCenter(int cell, int channelBits) {
+    if (channelBits >= 8)
+        return cell;
+    return (cell << (8 - channelBits)) | (1 << (7 - channelBits));
+}
+
+// @brief Gets the entries that may be the most similar for some color in the box, ascending by the index.
+// @note An entry is kept if its nearest distance to the box is not greater than the smallest farthest distance
+//       of all entries, so all the tied entries of any color in the box are kept.
+static void boxCandidates(const int lo[3], const int hi[3], const BIModis &modis, int type,
+                          std::vector<int> &result)
+{
+    const int *w = _Weights[type];
+    result.clear();
+    long long bound = LLONG_MAX;
+    for (auto &var : modis) {
+        int c[3] = { var.color.r, var.color.g, var.color.b };
+        long long far = 0;
+        for (int i = 0; i < 3; ++i)
+            far += static_cast<long long>(w[i]) * std::max(square(c[i] - lo[i]), square(c[i] - hi[i]));
+        bound = std::min(bound, far);
+    }
+    for (int index = 0; index < static_cast<int>(modis.size()); ++index) {
+        const Rgb &color = modis[index].color;
+        int c[3] = { color.r, color.g, color.b };
+        long long near = 0;
+        for (int i = 0; i < 3; ++i) {
+            int d = c[i] < lo[i] ? lo[i] - c[i] : (c[i] > hi[i] ? c[i] - hi[i] : 0);
+            near += static_cast<long long>(w[i]) * square(d);
+        }
+        if (near <= bound)
+            result.push_back(index);
+    }
+}
+
+// @brief Gets the index of the most similar entry among the candidates.
+static int nearestAmong(const Rgb &rgb, const BIModis &modis, int type, const std::vector<int> &candidates,
+                        std::vector<int> &ties)
+{
+    int best = INT_MAX;
+    ties.clear();
+    for (int index : candidates) {
+        int d = weightedDistance(rgb, modis[index].color, type);
+        if (d > best)
+            continue;
+        if (d < best) {
+            best = d;
+            ties.clear();
+        }
+        ties.push_back(index);
+    }
+    if (ties.size() == 1)
+        return ties[0];
+    return resolveTies(rgb, modis, type, ties.data(), static_cast<int>(ties.size()));
+}
+
+int resolveTies(const Rgb &rgb, const BIModis &modis, int type, const int *indices, int count) {
+    if (count <= 0)
+        return -1;
+    int result = -1;
+    double similarity = 0;
+    for (int i = 0; i < count; ++i) {
+        double sim = rgbSimilarity(rgb, modis[indices[i]].color, type);
+        if (similarity > sim)
+            continue;
+        similarity = sim;
+        result = indices[i];
+    }
+    // Only happens when the rounding makes all the similarity less than 0.
+    return result == -1 ? indices[count - 1] : result;
+}
+
+int nearestIndex(const Rgb &rgb, const BIModis &modis, int type) {
+    if (modis.empty())
+        return -1;
+    // All the similarity of the unknown type are the same, so the last entry wins.
+    if (!isValidType(type))
+        return static_cast<int>(modis.size()) - 1;
+    int best = INT_MAX;
+    int result = 0;
+    bool isTied = false;
+    for (int index = 0; index < static_cast<int>(modis.size()); ++index) {
+        int d = weightedDistance(rgb, modis[index].color, type);
+        if (d > best)
+            continue;
+        isTied = d == best;
+        best = d;
+        result = index;
+    }
+    if (!isTied)
+        return result;
+    std::vector<int> ties;
+    for (int index = 0; index < static_cast<int>(modis.size()); ++index) {
+        if (weightedDistance(rgb, modis[index].color, type) == best)
+            ties.push_back(index);
+    }
+    return resolveTies(rgb, modis, type, ties.data(), static_cast<int>(ties.size()));
+}
+
+std::uint64_t paletteHash(const BIModis &modis) {
+    // FNV-1a.
+    std::uint64_t hash = 14695981039346656037ull;
+    auto feed = [&hash](unsigned char byte) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+    for (auto &var : modis) {
+        for (char ch : var.blockId)
+            feed(static_cast<unsigned char>(ch));
+        feed(0);
+        feed(var.color.r);
+        feed(var.color.g);
+        feed(var.color.b);
+    }
+    return hash;
+}
+
+void ColorLut::setBits(int bits) {
+    bits_ = bits;
+    channelBits_ = bits / 3;
+    shift_ = 8 - channelBits_;
+}
+
+ColorLut ColorLut::build(const BIModis &modis, int type, int bits, int threadCount) {
+    ColorLut result;
+    if (modis.empty() || modis.size() > 0xFFFF) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " <<
+            "The palette is empty or too large." << std::endl;
+        return result;
+    }
+    if (bits != Bits15 && bits != Bits18 && bits != Bits21 && bits != Bits24) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "The precision is invalid." << std::endl;
+        return result;
+    }
+    result.setBits(bits);
+    result.type_ = type;
+    result.paletteSize_ = static_cast<int>(modis.size());
+    result.paletteHash_ = Quantizer::paletteHash(modis);
+    result.data_ = std::make_shared<std::vector<std::uint16_t>>(std::size_t(1) << bits);
+    result.table_ = result.data_->data();
+    std::uint16_t *table = result.data_->data();
+
+    if (!isValidType(type)) {
+        std::fill(result.data_->begin(), result.data_->end(), static_cast<std::uint16_t>(modis.size() - 1));
+        return result;
+    }
+
+    // The cells are solved in groups of 5 bits per channel, every group only searches its candidates.
+    const int channelBits = result.channelBits_;
+    const int groupBits = std::min(channelBits, 5);
+    const int subBits = channelBits - groupBits;
+    const int groupSide = 1 << groupBits;
+    const int subSide = 1 << subBits;
+    parallelFor(0, groupSide * groupSide * groupSide, threadCount,
+                [&](int begin, int end, int) {
+        std::vector<int> candidates;
+        std::vector<int> ties;
+        for (int group = begin; group < end; ++group) {
+            int g[3] = { group >> (groupBits * 2), (group >> groupBits) & (groupSide - 1), group & (groupSide - 1) };
+            int lo[3];
+            int hi[3];
+            for (int i = 0; i < 3; ++i) {
+                lo[i] = cellCenter(g[i] << subBits, channelBits);
+                hi[i] = cellCenter((g[i] << subBits) + subSide - 1, channelBits);
+            }
+            boxCandidates(lo, hi, modis, type, candidates);
+            for (int r = 0; r < subSide; ++r) {
+                for (int gr = 0; gr < subSide; ++gr) {
+                    for (int b = 0; b < subSide; ++b) {
+                        int cell[3] = { (g[0] << subBits) + r, (g[1] << subBits) + gr, (g[2] << subBits) + b };
+                        Rgb color(cellCenter(cell[0], channelBits), cellCenter(cell[1], channelBits),
+                                  cellCenter(cell[2], channelBits));
+                        std::size_t index = (static_cast<std::size_t>(cell[0]) << (channelBits * 2)) |
+                            (static_cast<std::size_t>(cell[1]) << channelBits) | cell[2];
+                        table[index] = static_cast<std::uint16_t>(nearestAmong(color, modis, type, candidates, ties));
+                    }
+                }
+            }
+        }
+    });
+    return result;
+}
+
+ColorLut ColorLut::load(const std::string &filepath, const BIModis &modis, int type) {
+    ColorLut result;
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(filepath) || file->size() < sizeof(LutFileHeader))
+        return result;
+    LutFileHeader header;
+    LutFileHeader expected;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.byteOrder != expected.byteOrder || header.formatVersion != expected.formatVersion)
+        return result;
+    if (header.bits != Bits15 && header.bits != Bits18 && header.bits != Bits21 && header.bits != Bits24)
+        return result;
+    if (header.type != type || header.paletteSize != modis.size() ||
+        header.paletteHash != Quantizer::paletteHash(modis))
+        return result;
+    std::size_t tableSize = (std::size_t(1) << header.bits) * sizeof(std::uint16_t);
+    if (file->size() != sizeof(header) + tableSize)
+        return result;
+    result.setBits(static_cast<int>(header.bits));
+    result.type_ = type;
+    result.paletteSize_ = static_cast<int>(header.paletteSize);
+    result.paletteHash_ = header.paletteHash;
+    result.table_ = reinterpret_cast<const std::uint16_t *>(file->data() + sizeof(header));
+    result.file_ = file;
+    return result;
+}
+
+bool ColorLut::save(const std::string &filepath) const {
+    if (empty())
+        return false;
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Failed to open file." << std::endl;
+        return false;
+    }
+    LutFileHeader header;
+    header.bits = bits_;
+    header.type = type_;
+    header.paletteSize = paletteSize_;
+    header.paletteHash = paletteHash_;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(table_), (std::size_t(1) << bits_) * sizeof(std::uint16_t));
+    return file.good();
+}
+
+ColorLut::DiffReport ColorLut::diff(const BIModis &modis, std::size_t maxMismatches, int threadCount) const {
+    DiffReport report;
+    if (empty() || modis.size() != static_cast<std::size_t>(paletteSize_))
+        return report;
+    report.checked = std::uint64_t(1) << 24;
+    if (bits_ == Bits24 || !isValidType(type_))
+        return report;
+
+    // Every worker takes contiguous groups, so the merged mismatches are ascending.
+    std::vector<DiffReport> parts(workerCount(threadCount));
+    parallelFor(0, 1 << 15, threadCount, [&](int begin, int end, int worker) {
+        DiffReport &part = parts[worker];
+        std::vector<int> candidates;
+        std::vector<int> ties;
+        for (int group = begin; group < end; ++group) {
+            int lo[3] = { (group >> 10) << 3, ((group >> 5) & 31) << 3, (group & 31) << 3 };
+            int hi[3] = { lo[0] + 7, lo[1] + 7, lo[2] + 7 };
+            boxCandidates(lo, hi, modis, type_, candidates);
+            for (int r = lo[0]; r <= hi[0]; ++r) {
+                for (int g = lo[1]; g <= hi[1]; ++g) {
+                    for (int b = lo[2]; b <= hi[2]; ++b) {
+                        Rgb color(r, g, b);
+                        int index = (*this)(color);
+                        int exactIndex = nearestAmong(color, modis, type_, candidates, ties);
+                        if (index == exactIndex)
+                            continue;
+                        ++part.mismatched;
+                        if (maxMismatches == 0 || part.mismatches.size() < maxMismatches) {
+                            Mismatch mismatch;
+                            mismatch.color = color;
+                            mismatch.index = index;
+                            mismatch.exactIndex = exactIndex;
+                            part.mismatches.push_back(mismatch);
+                        }
+                    }
+                }
+            }
+        }
+    });
+    for (auto &part : parts) {
+        report.mismatched += part.mismatched;
+        for (auto &var : part.mismatches) {
+            if (maxMismatches != 0 && report.mismatches.size() >= maxMismatches)
+                break;
+            report.mismatches.push_back(var);
+        }
+    }
+    return report;
+}
+
+// The max entries count of a leaf node.
+constexpr int _KdLeafSize = 8;
+
+KdTree::KdTree(const BIModis &modis, int type) :
+    modis_(&modis), type_(type)
+{
+    if (modis.empty())
+        return;
+    order_.resize(modis.size());
+    for (int i = 0; i < static_cast<int>(order_.size()); ++i)
+        order_[i] = i;
+    nodes_.reserve(2 * (modis.size() / _KdLeafSize + 1));
+    build(0, static_cast<int>(order_.size()));
+    colors_.reserve(order_.size());
+    for (int index : order_)
+        colors_.push_back(modis[index].color);
+}
+
+int KdTree::build(int begin, int end) {
+    const BIModis &modis = *modis_;
+    int nodeIndex = static_cast<int>(nodes_.size());
+    nodes_.emplace_back();
+    Node node;
+    node.begin = begin;
+    node.end = end;
+    int lo[3] = { 255, 255, 255 };
+    int hi[3] = { 0, 0, 0 };
+    for (int i = begin; i < end; ++i) {
+        const Rgb &color = modis[order_[i]].color;
+        int c[3] = { color.r, color.g, color.b };
+        for (int axis = 0; axis < 3; ++axis) {
+            lo[axis] = std::min(lo[axis], c[axis]);
+            hi[axis] = std::max(hi[axis], c[axis]);
+        }
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        node.lo[axis] = static_cast<unsigned char>(lo[axis]);
+        node.hi[axis] = static_cast<unsigned char>(hi[axis]);
+    }
+    if (end - begin > _KdLeafSize) {
+        // Split at the median of the axis which has the widest weighted spread.
+        const int *w = _Weights[isValidType(type_) ? type_ : 0];
+        int splitAxis = 0;
+        long long spread = -1;
+        for (int axis = 0; axis < 3; ++axis) {
+            long long s = static_cast<long long>(w[axis]) * square(hi[axis] - lo[axis]);
+            if (s > spread) {
+                spread = s;
+                splitAxis = axis;
+            }
+        }
+        auto channel = [&modis, splitAxis](int index) {
+            const Rgb &color = modis[index].color;
+            return splitAxis == 0 ? color.r : (splitAxis == 1 ? color.g : color.b);
+        };
+        int mid = begin + (end - begin) / 2;
+        std::nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+                         [&channel](int a, int b) { return channel(a) < channel(b); });
+        node.left = build(begin, mid);
+        node.right = build(mid, end);
+    }
+    nodes_[nodeIndex] = node;
+    return nodeIndex;
+}
+
+int KdTree::nearest(const Rgb &rgb) const {
+    if (empty())
+        return -1;
+    if (!isValidType(type_))
+        return paletteSize() - 1;
+    const int *w = _Weights[type_];
+    const int c[3] = { rgb.r, rgb.g, rgb.b };
+    auto boxDistance = [w, &c](const Node &node) {
+        int d = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            int delta = c[axis] < node.lo[axis] ? node.lo[axis] - c[axis] :
+                (c[axis] > node.hi[axis] ? c[axis] - node.hi[axis] : 0);
+            d += w[axis] * delta * delta;
+        }
+        return d;
+    };
+
+    int best = INT_MAX;
+    int ties[_MaxTies];
+    int tieCount = 0;
+    bool isOverflow = false;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes_[stack[--top]];
+        // The tied entries may be in the box of the same distance, so only prune the farther boxes.
+        if (boxDistance(node) > best)
+            continue;
+        if (node.left == -1) {
+            for (int i = node.begin; i < node.end; ++i) {
+                int d = weightedDistance(rgb, colors_[i], type_);
+                if (d > best)
+                    continue;
+                if (d < best) {
+                    best = d;
+                    tieCount = 0;
+                    isOverflow = false;
+                }
+                if (tieCount == _MaxTies)
+                    isOverflow = true;
+                else
+                    ties[tieCount++] = order_[i];
+            }
+            continue;
+        }
+        // Visit the nearer child first, so the farther one is more likely pruned.
+        int nearChild = node.left;
+        int farChild = node.right;
+        if (boxDistance(nodes_[farChild]) < boxDistance(nodes_[nearChild]))
+            std::swap(nearChild, farChild);
+        stack[top++] = farChild;
+        stack[top++] = nearChild;
+    }
+    if (isOverflow)
+        return nearestIndex(rgb, *modis_, type_);
+    if (tieCount == 1)
+        return ties[0];
+    std::sort(ties, ties + tieCount);
+    return resolveTies(rgb, *modis_, type_, ties, tieCount);
+}
+
+// The kernels of the palette search, the min one gets the smallest weighted distance of the entries,
+// the ties one records the entries of the distance and returns the count of them (may greater than maxTies).
+
+static int minDistanceScalar(const std::int32_t *r, const std::int32_t *g, const std::int32_t *b,
+                             int begin, int end, const int q[3], const int w[3], int best)
+{
+    for (int i = begin; i < end; ++i) {
+        int d = w[0] * square(r[i] - q[0]) + w[1] * square(g[i] - q[1]) + w[2] * square(b[i] - q[2]);
+        best = d < best ? d : best;
+    }
+    return best;
+}
+
+static int collectTiesScalar(const std::int32_t *r, const std::int32_t *g, const std::int32_t *b,
+                             int begin, int end, const int q[3], const int w[3], int best,
+                             int *ties, int maxTies, int tieCount)
+{
+    for (int i = begin; i < end; ++i) {
+        int d = w[0] * square(r[i] - q[0]) + w[1] * square(g[i] - q[1]) + w[2] * square(b[i] - q[2]);
+        if (d != best)
+            continue;
+        if (tieCount < maxTies)
+            ties[tieCount] = i;
+        ++tieCount;
+    }
+    return tieCount;
+}
+
+#ifdef QUANTIZER_X86
+
+// @brief Multiplies the 32-bit lanes and keeps the low 32 bits, SSE2 has no pmulld.
+QUANTIZER_TARGET_SSE2 static inline __m128i mullo32Sse2(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+QUANTIZER_TARGET_SSE2 static inline __m128i distanceSse2(const std::int32_t *r, const std::int32_t *g,
+                                                         const std::int32_t *b, int i, const __m128i q[3],
+                                                         const __m128i w[3])
+{
+    __m128i dr = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r + i)), q[0]);
+    __m128i dg = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(g + i)), q[1]);
+    __m128i db = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)), q[2]);
+    __m128i d = mullo32Sse2(mullo32Sse2(dr, dr), w[0]);
+    d = _mm_add_epi32(d, mullo32Sse2(mullo32Sse2(dg, dg), w[1]));
+    return _mm_add_epi32(d, mullo32Sse2(mullo32Sse2(db, db), w[2]));
+}
+
+QUANTIZER_TARGET_SSE2 static int minDistanceSse2(const std::int32_t *r, const std::int32_t *g,
+                                                 const std::int32_t *b, int count, const int q[3], const int w[3])
+{
+    const __m128i vq[3] = { _mm_set1_epi32(q[0]), _mm_set1_epi32(q[1]), _mm_set1_epi32(q[2]) };
+    const __m128i vw[3] = { _mm_set1_epi32(w[0]), _mm_set1_epi32(w[1]), _mm_set1_epi32(w[2]) };
+    __m128i vbest = _mm_set1_epi32(INT_MAX);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = distanceSse2(r, g, b, i, vq, vw);
+        // SSE2 has no pminsd.
+        __m128i isLess = _mm_cmplt_epi32(d, vbest);
+        vbest = _mm_or_si128(_mm_and_si128(isLess, d), _mm_andnot_si128(isLess, vbest));
+    }
+    alignas(16) std::int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), vbest);
+    int best = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    return minDistanceScalar(r, g, b, i, count, q, w, best);
+}
+
+QUANTIZER_TARGET_SSE2 static int collectTiesSse2(const std::int32_t *r, const std::int32_t *g,
+                                                 const std::int32_t *b, int count, const int q[3], const int w[3],
+                                                 int best, int *ties, int maxTies)
+{
+    const __m128i vq[3] = { _mm_set1_epi32(q[0]), _mm_set1_epi32(q[1]), _mm_set1_epi32(q[2]) };
+    const __m128i vw[3] = { _mm_set1_epi32(w[0]), _mm_set1_epi32(w[1]), _mm_set1_epi32(w[2]) };
+    const __m128i vbest = _mm_set1_epi32(best);
+    int tieCount = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = distanceSse2(r, g, b, i, vq, vw);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(d, vbest)));
+        for (int lane = 0; mask != 0; ++lane, mask >>= 1) {
+            if ((mask & 1) == 0)
+                continue;
+            if (tieCount < maxTies)
+                ties[tieCount] = i + lane;
+            ++tieCount;
+        }
+    }
+    return collectTiesScalar(r, g, b, i, count, q, w, best, ties, maxTies, tieCount);
+}
+
+QUANTIZER_TARGET_AVX2 static inline __m256i distanceAvx2(const std::int32_t *r, const std::int32_t *g,
+                                                         const std::int32_t *b, int i, const __m256i q[3],
+                                                         const __m256i w[3])
+{
+    __m256i dr = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(r + i)), q[0]);
+    __m256i dg = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(g + i)), q[1]);
+    __m256i db = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i)), q[2]);
+    __m256i d = _mm256_mullo_epi32(_mm256_mullo_epi32(dr, dr), w[0]);
+    d = _mm256_add_epi32(d, _mm256_mullo_epi32(_mm256_mullo_epi32(dg, dg), w[1]));
+    return _mm256_add_epi32(d, _mm256_mullo_epi32(_mm256_mullo_epi32(db, db), w[2]));
+}
+
+QUANTIZER_TARGET_AVX2 static int minDistanceAvx2(const std::int32_t *r, const std::int32_t *g,
+                                                 const std::int32_t *b, int count, const int q[3], const int w[3])
+{
+    const __m256i vq[3] = { _mm256_set1_epi32(q[0]), _mm256_set1_epi32(q[1]), _mm256_set1_epi32(q[2]) };
+    const __m256i vw[3] = { _mm256_set1_epi32(w[0]), _mm256_set1_epi32(w[1]), _mm256_set1_epi32(w[2]) };
+    __m256i vbest = _mm256_set1_epi32(INT_MAX);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        vbest = _mm256_min_epi32(vbest, distanceAvx2(r, g, b, i, vq, vw));
+    alignas(32) std::int32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), vbest);
+    int best = INT_MAX;
+    for (int lane = 0; lane < 8; ++lane)
+        best = std::min(best, lanes[lane]);
+    return minDistanceScalar(r, g, b, i, count, q, w, best);
+}
+
+QUANTIZER_TARGET_AVX2 static int collectTiesAvx2(const std::int32_t *r, const std::int32_t *g,
+                                                 const std::int32_t *b, int count, const int q[3], const int w[3],
+                                                 int best, int *ties, int maxTies)
+{
+    const __m256i vq[3] = { _mm256_set1_epi32(q[0]), _mm256_set1_epi32(q[1]), _mm256_set1_epi32(q[2]) };
+    const __m256i vw[3] = { _mm256_set1_epi32(w[0]), _mm256_set1_epi32(w[1]), _mm256_set1_epi32(w[2]) };
+    const __m256i vbest = _mm256_set1_epi32(best);
+    int tieCount = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i d = distanceAvx2(r, g, b, i, vq, vw);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(d, vbest)));
+        for (int lane = 0; mask != 0; ++lane, mask >>= 1) {
+            if ((mask & 1) == 0)
+                continue;
+            if (tieCount < maxTies)
+                ties[tieCount] = i + lane;
+            ++tieCount;
+        }
+    }
+    return collectTiesScalar(r, g, b, i, count, q, w, best, ties, maxTies, tieCount);
+}
+
+#endif // QUANTIZER_X86
+
+SimdLevel detectSimdLevel() {
+#ifdef QUANTIZER_X86
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool hasSse2 = (info[3] & (1 << 26)) != 0;
+    bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+    bool hasAvx = (info[2] & (1 << 28)) != 0;
+    if (maxLeaf >= 7 && hasOsxsave && hasAvx && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5))
+            return SimdLevel::Avx2;
+    }
+    return hasSse2 ? SimdLevel::Sse2 : SimdLevel::Scalar;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::Avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return SimdLevel::Sse2;
+    return SimdLevel::Scalar;
+#endif // _MSC_VER
+#else
+    return SimdLevel::Scalar;
+#endif // QUANTIZER_X86
+}
+
+SoaPalette::SoaPalette(const BIModis &modis, int type, SimdLevel level) :
+    modis_(&modis), type_(type)
+{
+    static const SimdLevel supported = detectSimdLevel();
+    level_ = static_cast<char>(level) < static_cast<char>(supported) ? level : supported;
+    r_.reserve(modis.size());
+    g_.reserve(modis.size());
+    b_.reserve(modis.size());
+    for (auto &var : modis) {
+        r_.push_back(var.color.r);
+        g_.push_back(var.color.g);
+        b_.push_back(var.color.b);
+    }
+}
+
+int SoaPalette::nearest(const Rgb &rgb) const {
+    if (empty())
+        return -1;
+    if (!isValidType(type_))
+        return paletteSize() - 1;
+    const int q[3] = { rgb.r, rgb.g, rgb.b };
+    const int *w = _Weights[type_];
+    const int count = paletteSize();
+    int ties[_MaxTies];
+    int best = 0;
+    int tieCount = 0;
+    switch (level_) {
+#ifdef QUANTIZER_X86
+        case SimdLevel::Avx2:
+            best = minDistanceAvx2(r_.data(), g_.data(), b_.data(), count, q, w);
+            tieCount = collectTiesAvx2(r_.data(), g_.data(), b_.data(), count, q, w, best, ties, _MaxTies);
+            break;
+        case SimdLevel::Sse2:
+            best = minDistanceSse2(r_.data(), g_.data(), b_.data(), count, q, w);
+            tieCount = collectTiesSse2(r_.data(), g_.data(), b_.data(), count, q, w, best, ties, _MaxTies);
+            break;
+#endif // QUANTIZER_X86
+        default:
+            best = minDistanceScalar(r_.data(), g_.data(), b_.data(), 0, count, q, w, INT_MAX);
+            tieCount = collectTiesScalar(r_.data(), g_.data(), b_.data(), 0, count, q, w, best, ties, _MaxTies, 0);
+            break;
+    }
+    if (tieCount == 1)
+        return ties[0];
+    if (tieCount > _MaxTies)
+        return nearestIndex(rgb, *modis_, type_);
+    return resolveTies(rgb, *modis_, type_, ties, tieCount);
+}
+
+SearchBenchmark benchmarkSearch(const BIModis &modis, int type, int queryCount) {
+    using Clock = std::chrono::steady_clock;
+
+    SearchBenchmark result;
+    result.paletteSize = static_cast<int>(modis.size());
+    result.queryCount = queryCount;
+    if (modis.empty() || queryCount <= 0)
+        return result;
+
+    std::vector<Rgb> queries;
+    queries.reserve(queryCount);
+    std::mt19937 rng(20240601);
+    std::uniform_int_distribution<int> uni(0, 255);
+    for (int i = 0; i < queryCount; ++i)
+        queries.emplace_back(uni(rng), uni(rng), uni(rng));
+    std::vector<int> linearResult(queryCount);
+    std::vector<int> treeResult(queryCount);
+
+    auto start = Clock::now();
+    for (int i = 0; i < queryCount; ++i)
+        linearResult[i] = nearestIndex(queries[i], modis, type);
+    result.linear = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queryCount;
+
+    // The building time is not included.
+    KdTree tree(modis, type);
+    start = Clock::now();
+    for (int i = 0; i < queryCount; ++i)
+        treeResult[i] = tree.nearest(queries[i]);
+    result.kdTree = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queryCount;
+
+    SoaPalette soa(modis, type);
+    std::vector<int> soaResult(queryCount);
+    result.simdLevel = soa.simdLevel();
+    start = Clock::now();
+    for (int i = 0; i < queryCount; ++i)
+        soaResult[i] = soa.nearest(queries[i]);
+    result.soa = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queryCount;
+
+    for (int i = 0; i < queryCount; ++i) {
+        if (linearResult[i] != treeResult[i] || linearResult[i] != soaResult[i])
+            ++result.mismatched;
+    }
+    return result;
+}
+
+void Matcher::setLut(const ColorLut &lut) {
+    if (!lut.empty() && (lut.type() != type_ || lut.paletteSize() != static_cast<int>(modis_->size()))) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " <<
+            "The table is not built from the palette." << std::endl;
+        return;
+    }
+    lut_ = lut;
+}
+
+void Matcher::setKdTree(std::shared_ptr<const KdTree> tree) {
+    if (tree && (tree->type() != type_ || tree->paletteSize() != static_cast<int>(modis_->size()))) {
+        std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " <<
+            "The index is not built from the palette." << std::endl;
+        return;
+    }
+    tree_ = std::move(tree);
+}
+
+}
@@ -0,0 +1,302 @@
+#ifndef QUANTIZER_HPP
+#define QUANTIZER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "preprocess.hpp"
+
+class MappedFile;
+
+namespace Quantizer
+{
+
+// @brief Gets the similarity of two colors by the weighted metric, the type is 0 or 1.
+// @return The value in [0, 1], 0 for the unknown type.
+inline double rgbSimilarity(const Rgb &a, const Rgb &b, int type) {
+    if (type == 0)
+        return 1. - (square<double>(a.r - b.r) * 0.32 + square<double>(a.g - b.g) * 0.52 +
+                     square<double>(a.b - b.b) * 0.16) / 65025;
+    if (type == 1)
+        return 1. - (square<double>(a.r - b.r) * 0.299 + square<double>(a.g - b.g) * 0.587 +
+                     square<double>(a.b - b.b) * 0.114) / 65025;
+    return 0;
+}
+
+// The integer weights of the similarity types, they keep the same ratio as rgbSimilarity.
+constexpr int _Weights[2][3] = {
+    { 32, 52, 16 },
+    { 299, 587, 114 }
+};
+
+// @brief Gets the weighted squared distance of two colors, the smaller the more similar.
+// @note Only for the type 0 and 1, the order is the same as rgbSimilarity except the exact ties.
+inline int weightedDistance(const Rgb &a, const Rgb &b, int type) {
+    return _Weights[type][0] * square(a.r - b.r) + _Weights[type][1] * square(a.g - b.g) +
+        _Weights[type][2] * square(a.b - b.b);
+}
+
+// @brief Picks the result from the entries which have the same smallest weighted distance.
+// @param indices The tied entries index, must be ascending.
+// @note The tie breaking is the same as the linear search, keeps the last entry that its similarity is not less
+//       than the best so far. The double math may break the integer ties, so replay it on the tied entries.
+int resolveTies(const Rgb &rgb, const BIModis &modis, int type, const int *indices, int count);
+
+// @brief Gets the index of the most similar entry in the palette by the linear search.
+// @return -1 if the palette is empty.
+int nearestIndex(const Rgb &rgb, const BIModis &modis, int type = 0);
+
+// @brief Gets the fingerprint of the palette, it changes when any block id or color changes.
+std::uint64_t paletteHash(const BIModis &modis);
+
+// @brief The precomputed table of color to palette index.
+// @note The copies share the same table.
+class ColorLut
+{
+public:
+    // The usable precisions, that is the bits of a whole color.
+    enum Precision : int
+    {
+        Bits15 = 15,
+        Bits18 = 18,
+        Bits21 = 21,
+        // Full precision, the result is the same as the linear search.
+        Bits24 = 24
+    };
+
+    struct Mismatch
+    {
+        Rgb color;
+        // The result of the table.
+        int index = 0;
+        // The result of the linear search.
+        int exactIndex = 0;
+    };
+
+    struct DiffReport
+    {
+        // The count of the checked colors.
+        std::uint64_t checked = 0;
+        // The count of the colors which the table changes the answer.
+        std::uint64_t mismatched = 0;
+        // The mismatched colors, ascending by the 24-bit color value.
+        std::vector<Mismatch> mismatches;
+    };
+
+    ColorLut() {}
+
+    // @brief Builds the table of the palette, every cell takes the result of its center color.
+    // @param bits One of Precision.
+    // @param threadCount The worker count, 0 means the hardware concurrency.
+    // @return The empty table if the arguments are invalid.
+    static ColorLut build(const BIModis &modis, int type = 0, int bits = Bits18, int threadCount = 0);
+
+    // @brief Loads the table saved by save() through the memory mapping.
+    // @return The empty table if the file is invalid, of the other byte order, or not built from the palette and
+    //         type, so the caller builds it again.
+    static ColorLut load(const std::string &filepath, const BIModis &modis, int type = 0);
+
+    bool save(const std::string &filepath) const;
+
+    // @brief Compares with the linear search of the palette on all 24-bit colors.
+    // @param maxMismatches The max count of the recorded mismatches, 0 means record all.
+    DiffReport diff(const BIModis &modis, std::size_t maxMismatches = 1024, int threadCount = 0) const;
+
+    bool empty() const {
+        return table_ == nullptr;
+    }
+    int bits() const {
+        return bits_;
+    }
+    int type() const {
+        return type_;
+    }
+    int paletteSize() const {
+        return paletteSize_;
+    }
+    std::uint64_t paletteHash() const {
+        return paletteHash_;
+    }
+
+    int operator()(const Rgb &rgb) const {
+        return table_[cellIndex(rgb)];
+    }
+
+private:
+    std::size_t cellIndex(const Rgb &rgb) const {
+        return (static_cast<std::size_t>(rgb.r >> shift_) << (channelBits_ * 2)) |
+            (static_cast<std::size_t>(rgb.g >> shift_) << channelBits_) | (rgb.b >> shift_);
+    }
+    void setBits(int bits);
+
+    const std::uint16_t *table_ = nullptr;
+    std::shared_ptr<std::vector<std::uint16_t>> data_;
+    std::shared_ptr<MappedFile> file_;
+    int bits_ = 0;
+    int channelBits_ = 0;
+    int shift_ = 0;
+    int type_ = 0;
+    int paletteSize_ = 0;
+    std::uint64_t paletteHash_ = 0;
+};
+
+// @brief The exact nearest search index of the palette colors, it honours the weighted metric of the type.
+// @note Only keeps the reference of the palette, the palette must outlive it.
+class KdTree
+{
+public:
+    KdTree() {}
+    explicit KdTree(const BIModis &modis, int type = 0);
+
+    bool empty() const {
+        return nodes_.empty();
+    }
+    int type() const {
+        return type_;
+    }
+    int paletteSize() const {
+        return static_cast<int>(order_.size());
+    }
+
+    // @brief Gets the index of the most similar entry, the result is the same as nearestIndex().
+    int nearest(const Rgb &rgb) const;
+
+private:
+    struct Node
+    {
+        // The entries range in the order.
+        int begin = 0;
+        int end = 0;
+        // The child nodes, -1 for the leaf.
+        int left = -1;
+        int right = -1;
+        // The bounding box of the entries colors.
+        unsigned char lo[3] = { 0, 0, 0 };
+        unsigned char hi[3] = { 0, 0, 0 };
+    };
+
+    int build(int begin, int end);
+
+    std::vector<Node> nodes_;
+    // The entries index, the entries of a node are contiguous.
+    std::vector<int> order_;
+    // The entries color in the order.
+    std::vector<Rgb> colors_;
+    const BIModis *modis_ = nullptr;
+    int type_ = 0;
+};
+
+// The instruction sets of the palette search kernel.
+enum class SimdLevel : char
+{
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// @brief Gets the best instruction set that the running CPU supports.
+SimdLevel detectSimdLevel();
+
+// @brief The palette colors in separate channel arrays, searched by the SIMD kernel.
+// @note Only keeps the reference of the palette, the palette must outlive it.
+class SoaPalette
+{
+public:
+    SoaPalette() {}
+    // @param level The instruction set to use, it is lowered to the supported one.
+    explicit SoaPalette(const BIModis &modis, int type = 0, SimdLevel level = SimdLevel::Avx2);
+
+    bool empty() const {
+        return r_.empty();
+    }
+    int type() const {
+        return type_;
+    }
+    int paletteSize() const {
+        return static_cast<int>(r_.size());
+    }
+    SimdLevel simdLevel() const {
+        return level_;
+    }
+
+    // @brief Gets the index of the most similar entry, the result is the same as nearestIndex().
+    int nearest(const Rgb &rgb) const;
+
+private:
+    std::vector<std::int32_t> r_;
+    std::vector<std::int32_t> g_;
+    std::vector<std::int32_t> b_;
+    const BIModis *modis_ = nullptr;
+    int type_ = 0;
+    SimdLevel level_ = SimdLevel::Scalar;
+};
+
+// The average search time of the methods, in nanoseconds per query.
+struct SearchBenchmark
+{
+    int paletteSize = 0;
+    int queryCount = 0;
+    double linear = 0;
+    double kdTree = 0;
+    double soa = 0;
+    SimdLevel simdLevel = SimdLevel::Scalar;
+    // The count of the queries which the methods get the different answers, it should be 0.
+    int mismatched = 0;
+};
+
+// @brief Times the search methods with the same random colors on the palette.
+SearchBenchmark benchmarkSearch(const BIModis &modis, int type = 0, int queryCount = 1 << 18);
+
+// @brief Maps the colors to the palette entries.
+// @note Only keeps the reference of the palette, the palette must outlive it.
+//       Without the table or index, it searches by the SIMD kernel which is built in the constructor.
+class Matcher
+{
+public:
+    Matcher(const BIModis &modis, int type = 0) :
+        modis_(&modis), type_(type), soa_(std::make_shared<SoaPalette>(modis, type)) {}
+
+    // @brief Uses the table for the search, it is ignored if it is not built from the palette size and type.
+    void setLut(const ColorLut &lut);
+    // @brief Uses the index for the search when has no table, it is ignored if it is not built from the palette.
+    void setKdTree(std::shared_ptr<const KdTree> tree);
+
+    const ColorLut &lut() const {
+        return lut_;
+    }
+    const std::shared_ptr<const KdTree> &kdTree() const {
+        return tree_;
+    }
+    const BIModis &modis() const {
+        return *modis_;
+    }
+    int type() const {
+        return type_;
+    }
+
+    // @brief Gets the index of the most similar entry, -1 if the palette is empty.
+    int nearest(const Rgb &rgb) const {
+        if (!lut_.empty())
+            return lut_(rgb);
+        if (tree_)
+            return tree_->nearest(rgb);
+        return soa_->nearest(rgb);
+    }
+
+    const BlockInfoModified &operator[](int index) const {
+        return (*modis_)[index];
+    }
+
+private:
+    const BIModis *modis_ = nullptr;
+    int type_ = 0;
+    ColorLut lut_;
+    std::shared_ptr<const KdTree> tree_;
+    std::shared_ptr<const SoaPalette> soa_;
+};
+
+}
+
+#endif // !QUANTIZER_HPP
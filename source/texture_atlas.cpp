@@ -0,0 +1,90 @@
+#include "texture_atlas.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "parallel.hpp"
+
+// The tile size when no texture can be read.
+constexpr int _DefaultTileSize = 16;
+
+TextureAtlas TextureAtlas::load(const BIModis &modis, const std::string &texturePath, int tileSize,
+                                int threadCount)
+{
+    TextureAtlas result;
+    if (modis.empty())
+        return result;
+
+    // Give every texture a slot.
+    std::unordered_map<std::string, int> slotMap;
+    std::vector<std::string> names;
+    for (auto &var : modis) {
+        auto it = slotMap.find(var.textureName);
+        if (it == slotMap.end()) {
+            it = slotMap.insert({ var.textureName, static_cast<int>(names.size()) }).first;
+            names.push_back(var.textureName);
+        }
+        result.slots_.push_back(it->second);
+    }
+
+    std::vector<cv::Mat> textures(names.size());
+    parallelFor(0, static_cast<int>(names.size()), threadCount, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i)
+            textures[i] = cv::imread(texturePath + "/" + names[i]);
+    });
+    if (tileSize <= 0) {
+        tileSize = _DefaultTileSize;
+        for (auto &texture : textures) {
+            if (!texture.empty()) {
+                tileSize = texture.cols;
+                break;
+            }
+        }
+    }
+
+    const std::size_t tileBytes = static_cast<std::size_t>(tileSize) * tileSize * 3;
+    auto data = std::make_shared<std::vector<unsigned char>>(tileBytes * names.size());
+    parallelFor(0, static_cast<int>(names.size()), threadCount, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            cv::Mat tile(tileSize, tileSize, CV_8UC3, data->data() + tileBytes * i);
+            cv::Mat &texture = textures[i];
+            if (texture.empty() || texture.type() != CV_8UC3) {
+                tile.setTo(cv::Scalar(255, 0, 255));
+                continue;
+            }
+            if (texture.cols == tileSize && texture.rows == tileSize) {
+                texture.copyTo(tile);
+                continue;
+            }
+            // The block textures are pixel art, so the enlarging keeps the pixels sharp.
+            int interpolation = texture.cols < tileSize ? cv::INTER_NEAREST : cv::INTER_AREA;
+            cv::resize(texture, tile, tile.size(), 0.0, 0.0, interpolation);
+        }
+    });
+    result.means_.resize(names.size() * 3);
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        const unsigned char *pixel = data->data() + tileBytes * i;
+        std::uint64_t sum[3] = { 0, 0, 0 };
+        for (std::size_t j = 0; j < tileBytes; j += 3) {
+            for (int c = 0; c < 3; ++c)
+                sum[c] += pixel[j + c];
+        }
+        for (int c = 0; c < 3; ++c)
+            result.means_[i * 3 + c] = static_cast<unsigned char>((sum[c] * 3 + tileBytes / 2) / tileBytes);
+    }
+    for (int i = 0; i < static_cast<int>(names.size()); ++i) {
+        if (textures[i].empty()) {
+            std::cerr << "In line " << __LINE__ << ", " << __FUNCTION__ << " " << "Can not read the texture " <<
+                names[i] << "." << std::endl;
+        }
+    }
+
+    result.data_ = data;
+    result.tileSize_ = tileSize;
+    return result;
+}
@@ -0,0 +1,53 @@
+#ifndef TEXTURE_ATLAS_HPP
+#define TEXTURE_ATLAS_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "preprocess.hpp"
+
+// @brief The textures of the palette entries, decoded once into a contiguous buffer of the square tiles.
+// @note The copies share the same buffer, so an atlas can be reused by the jobs of the same palette.
+class TextureAtlas
+{
+public:
+    TextureAtlas() {}
+
+    // @brief Decodes the textures of the palette, the entries with the same texture share a tile.
+    // @param tileSize The tile size in pixels, the textures of the other sizes are resized to it.
+    //                 0 means the size of the first texture.
+    // @param threadCount The worker count, 0 means the hardware concurrency.
+    // @note A texture which can not be read takes a magenta tile.
+    static TextureAtlas load(const BIModis &modis, const std::string &texturePath, int tileSize = 0,
+                             int threadCount = 0);
+
+    bool empty() const {
+        return data_ == nullptr;
+    }
+    int tileSize() const {
+        return tileSize_;
+    }
+    int paletteSize() const {
+        return static_cast<int>(slots_.size());
+    }
+
+    // @brief Gets the BGR pixels of the y row in the tile of the palette entry.
+    const unsigned char *row(int index, int y) const {
+        return data_->data() + (static_cast<std::size_t>(slots_[index]) * tileSize_ + y) * tileSize_ * 3;
+    }
+    // @brief Gets the average BGR color of the tile of the palette entry.
+    const unsigned char *mean(int index) const {
+        return means_.data() + static_cast<std::size_t>(slots_[index]) * 3;
+    }
+
+private:
+    std::shared_ptr<const std::vector<unsigned char>> data_;
+    // The tile of every palette entry.
+    std::vector<int> slots_;
+    // The average color of every tile.
+    std::vector<unsigned char> means_;
+    int tileSize_ = 0;
+};
+
+#endif // !TEXTURE_ATLAS_HPP